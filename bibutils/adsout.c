@@ -12,8 +12,10 @@
 #include <stdint.h>
 #include <string.h>
 #include <ctype.h>
+#include "bu_thread.h"
 #include "utf8.h"
 #include "str.h"
+#include "strhash.h"
 #include "strsearch.h"
 #include "fields.h"
 #include "generic.h"
@@ -454,15 +456,47 @@ get_firstinitial( fields *in )
 	} else return '\0';
 }
 
+/* journal names (journals[j]+6) hashed ignoring case, built once and
+ * then only read; strhash_add() keeps the first of repeated names as
+ * the linear scan did
+ */
+static strhash journals_hash;
+static int journals_hashed = 0;
+static bu_once_t journals_once = BU_ONCE_INIT;
+
+static void
+journals_build( void )
+{
+	int j;
+
+	strhash_init( &journals_hash, STRHASH_NOCASE );
+
+	for ( j=0; j<njournals; j++ ) {
+		if ( strhash_add( &journals_hash, journals[j]+6, j )!=STRHASH_OK ) {
+			strhash_free( &journals_hash );
+			return;
+		}
+	}
+
+	journals_hashed = 1;
+}
+
 static int
 get_journalabbr( fields *in )
 {
 	char *jrnl;
+	long m;
 	int n, j;
 
 	n = fields_find( in, "TITLE", LEVEL_HOST );
 	if ( n!=FIELDS_NOTFOUND ) {
 		jrnl = fields_value( in, n, FIELDS_CHRP );
+		bu_once( &journals_once, journals_build );
+		if ( journals_hashed ) {
+			m = strhash_find( &journals_hash, jrnl );
+			if ( m!=STRHASH_NOTFOUND ) return ( int ) m;
+			return -1;
+		}
 		for ( j=0; j<njournals; j++ ) {
 			if ( !strcasecmp( jrnl, journals[j]+6 ) )
 				return j;
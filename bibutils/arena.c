@@ -0,0 +1,201 @@
+/*
+ * arena.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Implements a chunked bump allocator
+ *
+ */
+#include <stdlib.h>
+#include <assert.h>
+#include "bu_thread.h"
+#include "arena.h"
+
+#define ARENA_BLOCKSIZE (65536)
+#define ARENA_ALIGN     (16)
+
+/* requests larger than this get a block of their own */
+#define ARENA_BIGALLOC  ( ARENA_BLOCKSIZE / 4 )
+
+/* first chunk a child takes from its parent; later ones double */
+#define ARENA_CHILDCHUNK (256)
+
+#define arena_round( n ) ( ( (n) + ARENA_ALIGN - 1 ) & ~( (size_t) ARENA_ALIGN - 1 ) )
+
+typedef struct arena_block {
+	struct arena_block *next;
+} arena_block;
+
+#define ARENA_HEADER arena_round( sizeof( arena_block ) )
+
+struct arena {
+	arena *top;             /* arena owning the blocks, self if top-level */
+	arena_block *blocks;    /* top-level only: every block handed out */
+	bu_mutex_t lock;   /* top-level only: guards blocks and pos/left */
+	char *pos;
+	size_t left;
+	size_t chunk;           /* children only: size of the next chunk */
+};
+
+/* arena_getblock()
+ *
+ * Returns size bytes of fresh memory owned by top; called with
+ * top->lock held.
+ */
+static char *
+arena_getblock( arena *top, size_t size )
+{
+	arena_block *b;
+
+	b = ( arena_block * ) malloc( ARENA_HEADER + size );
+	if ( !b ) return NULL;
+
+	b->next = top->blocks;
+	top->blocks = b;
+
+	return ( char * ) b + ARENA_HEADER;
+}
+
+static void *arena_bump( arena *a, size_t size );
+
+/* arena_childchunk()
+ *
+ * A child takes its memory from its parent's blocks in chunks that
+ * start small and double, so that the many children made for small
+ * references don't each hold on to a whole block.
+ */
+static char *
+arena_childchunk( arena *a, size_t size )
+{
+	size_t chunk = a->chunk;
+	char *p;
+
+	while ( chunk < size ) chunk *= 2;
+
+	bu_mutex_lock( &(a->top->lock) );
+	p = arena_bump( a->top, chunk );
+	bu_mutex_unlock( &(a->top->lock) );
+	if ( !p ) return NULL;
+
+	a->pos  = p;
+	a->left = chunk;
+	if ( chunk < ARENA_BIGALLOC ) a->chunk = chunk * 2;
+
+	return p;
+}
+
+static void *
+arena_bump( arena *a, size_t size )
+{
+	char *p;
+
+	size = arena_round( size ? size : 1 );
+
+	if ( size > a->left ) {
+		if ( size > ARENA_BIGALLOC ) {
+			if ( a->top!=a ) bu_mutex_lock( &(a->top->lock) );
+			p = arena_getblock( a->top, size );
+			if ( a->top!=a ) bu_mutex_unlock( &(a->top->lock) );
+			return p;
+		}
+		if ( a->top!=a ) {
+			if ( !arena_childchunk( a, size ) ) return NULL;
+		} else {
+			p = arena_getblock( a, ARENA_BLOCKSIZE );
+			if ( !p ) return NULL;
+			a->pos  = p;
+			a->left = ARENA_BLOCKSIZE;
+		}
+	}
+
+	p = a->pos;
+	a->pos  += size;
+	a->left -= size;
+
+	return p;
+}
+
+arena *
+arena_new( void )
+{
+	arena *a;
+
+	a = ( arena * ) malloc( sizeof( arena ) );
+	if ( !a ) return NULL;
+
+	if ( bu_mutex_init( &(a->lock) ) ) {
+		free( a );
+		return NULL;
+	}
+
+	a->top    = a;
+	a->blocks = NULL;
+	a->pos    = NULL;
+	a->left   = 0;
+	a->chunk  = 0;
+
+	return a;
+}
+
+/* arena_newchild()
+ *
+ * Children are allocated from (and freed with) the top-level arena.
+ */
+arena *
+arena_newchild( arena *parent )
+{
+	arena *a;
+
+	assert( parent );
+
+	a = ( arena * ) arena_alloc( parent->top, sizeof( arena ) );
+	if ( !a ) return NULL;
+
+	a->top    = parent->top;
+	a->blocks = NULL;
+	a->pos    = NULL;
+	a->left   = 0;
+	a->chunk  = ARENA_CHILDCHUNK;
+
+	return a;
+}
+
+void
+arena_delete( arena *a )
+{
+	arena_block *b, *next;
+
+	/* children go with their top-level arena */
+	if ( !a || a->top!=a ) return;
+
+	for ( b=a->blocks; b; b=next ) {
+		next = b->next;
+		free( b );
+	}
+
+	bu_mutex_free( &(a->lock) );
+	free( a );
+}
+
+/* arena_alloc()
+ *
+ * Returns ARENA_ALIGN-aligned memory, or NULL on memory error. The
+ * top-level arena can be shared between threads, children can't.
+ */
+void *
+arena_alloc( arena *a, size_t size )
+{
+	void *p;
+
+	assert( a );
+
+	if ( a->top!=a ) return arena_bump( a, size );
+
+	bu_mutex_lock( &(a->lock) );
+	p = arena_bump( a, size );
+	bu_mutex_unlock( &(a->lock) );
+
+	return p;
+}
@@ -0,0 +1,31 @@
+/*
+ * arena.h
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* arena
+ *
+ * A bump allocator: memory handed out by arena_alloc() is never freed
+ * on its own, it all goes away together in arena_delete().
+ *
+ * A child arena (arena_newchild()) takes its blocks from its parent
+ * and needs no deleting of its own. Children are not locked, so each
+ * one should only be used by one thread at a time, but any number of
+ * children of one parent can be used at once.
+ */
+typedef struct arena arena;
+
+arena *arena_new     ( void );
+arena *arena_newchild( arena *parent );
+void   arena_delete  ( arena *a );
+void * arena_alloc   ( arena *a, size_t size );
+
+#endif
@@ -8,7 +8,13 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include "bu_thread.h"
 #include "bibutils.h"
+#include "strhash.h"
+#include "intlist.h"
 
 /* internal includes */
 #include "reftypes.h"
@@ -20,6 +26,9 @@
 #define BIBL_INTERNALIN   (BIBL_LASTIN+1)
 #define BIBL_INTERNALOUT  (BIBL_LASTOUT+1)
 
+/* Size of the buffer handed to a p->readf set by the caller */
+#define BIBL_READBUFSIZE  (65536)
+
 #define debug_set( p ) ( (p)->verbose > 1 )
 #define verbose_set( p ) ( (p)->verbose )
 
@@ -85,6 +94,8 @@ report_params( FILE *fp, const char *f, param *p )
 	fprintf( fp, "\tutf8bom=%d\n", p->utf8bom );
 	fprintf( fp, "\tlatexout=%d\n", p->latexout );
 	fprintf( fp, "\txmlout=%d\n", p->xmlout );
+	fprintf( fp, "\tnthreads=%d\n", p->nthreads );
+	fprintf( fp, "\tusearena=%d\n", p->usearena );
 	fprintf( fp, "-------------------params end for %s\n", f );
 
 	fflush( fp );
@@ -92,25 +103,32 @@ report_params( FILE *fp, const char *f, param *p )
 
 /* bibl_duplicateparams()
  *
- * Returns status of BIBL_OK or BIBL_ERR_MEMERR
+ * Returns status of BIBL_OK or BIBL_ERR_MEMERR; on error np holds
+ * nothing that needs freeing.
  */
 static int
 bibl_duplicateparams( param *np, param *op )
 {
 	int status;
 
+	/* everything bibl_freeparams() frees, before anything can fail */
 	slist_init( &(np->asis) );
+	slist_init( &(np->corps) );
+	np->progname = NULL;
+
+	/* @STRING macros are local to each read */
+	strhash_init( &(np->stringnames), STRHASH_CASE );
+	slist_init( &(np->stringvalues) );
+
 	status = slist_copy( &(np->asis), &(op->asis ) );
-	if ( status!=SLIST_OK ) return BIBL_ERR_MEMERR;
+	if ( status!=SLIST_OK ) goto memerr;
 
-	slist_init( &(np->corps) );
 	status = slist_copy( &(np->corps), &(op->corps ) );
-	if ( status!=SLIST_OK ) return BIBL_ERR_MEMERR;
+	if ( status!=SLIST_OK ) goto memerr;
 
-	if ( !op->progname ) np->progname = NULL;
-	else {
+	if ( op->progname ) {
 		np->progname = strdup( op->progname );
-		if ( !np->progname ) return BIBL_ERR_MEMERR;
+		if ( !np->progname ) goto memerr;
 	}
 
 	np->readformat    = op->readformat;
@@ -134,8 +152,12 @@ bibl_duplicateparams( param *np, param *op )
 	np->addcount         = op->addcount;
 	np->output_raw       = op->output_raw;
 	np->singlerefperfile = op->singlerefperfile;
+	np->nthreads         = op->nthreads;
+	np->usearena         = op->usearena;
+	memset( &(np->stats), 0, sizeof( bibl_stats ) );
 
 	np->readf     = op->readf;
+	np->readbuf   = op->readbuf;
 	np->processf  = op->processf;
 	np->cleanf    = op->cleanf;
 	np->typef     = op->typef;
@@ -149,6 +171,9 @@ bibl_duplicateparams( param *np, param *op )
 	np->nall      = op->nall;
 
 	return BIBL_OK;
+memerr:
+	bibl_freeparams( np );
+	return BIBL_ERR_MEMERR;
 }
 
 /* bibl_setreadparams()
@@ -197,7 +222,10 @@ bibl_freeparams( param *p )
 	if ( p ) {
 		slist_free( &(p->asis) );
 		slist_free( &(p->corps) );
+		strhash_free( &(p->stringnames) );
+		slist_free( &(p->stringvalues) );
 		if ( p->progname ) free( p->progname );
+		p->progname = NULL;
 	}
 }
 
@@ -284,6 +312,112 @@ bibl_reporterr( int err )
 	fprintf( stderr, "\n" );
 }
 
+/* Statistics
+ *
+ * The working copy of param used inside bibl_read()/bibl_write()
+ * starts from zero and its totals are added to the caller's param
+ * when done. The caller's param may be shared between threads, so
+ * every access to its totals goes through stats_lock.
+ */
+static bu_mutex_t stats_lock = BU_MUTEX_INIT;
+
+static double
+bibl_clock( void )
+{
+#ifdef WIN32
+	return ( double ) clock() / CLOCKS_PER_SEC;
+#else
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ( double ) ts.tv_sec + ( double ) ts.tv_nsec / 1e9;
+#endif
+}
+
+static void
+bibl_stagedone( param *p, int stage, double start, long nrefs )
+{
+	p->stats.seconds[stage] += bibl_clock() - start;
+	p->stats.nrefs[stage]   += nrefs;
+}
+
+/* bibl_streampos()
+ *
+ * Returns the stream position, or -1 if it isn't seekable.
+ */
+static long
+bibl_streampos( FILE *fp )
+{
+	if ( !fp ) return -1;
+	return ftell( fp );
+}
+
+static void
+bibl_addbytes( long *bytes, long start, long end )
+{
+	if ( start >= 0 && end >= start ) *bytes += end - start;
+}
+
+static void
+bibl_addstats( param *p, bibl_stats *s )
+{
+	int i;
+
+	bu_mutex_lock( &stats_lock );
+	for ( i=0; i<BIBL_NSTAGES; ++i ) {
+		p->stats.seconds[i] += s->seconds[i];
+		p->stats.nrefs[i]   += s->nrefs[i];
+	}
+	p->stats.bytesin  += s->bytesin;
+	p->stats.bytesout += s->bytesout;
+	bu_mutex_unlock( &stats_lock );
+}
+
+void
+bibl_getstats( param *p, bibl_stats *s )
+{
+	bu_mutex_lock( &stats_lock );
+	*s = p->stats;
+	bu_mutex_unlock( &stats_lock );
+}
+
+void
+bibl_clearstats( param *p )
+{
+	bu_mutex_lock( &stats_lock );
+	memset( &(p->stats), 0, sizeof( bibl_stats ) );
+	bu_mutex_unlock( &stats_lock );
+}
+
+const char *
+bibl_stagename( int stage )
+{
+	switch ( stage ) {
+		case BIBL_STAGE_READ:          return "read";
+		case BIBL_STAGE_CLEAN:         return "clean";
+		case BIBL_STAGE_READCHARSETS:  return "readcharsets";
+		case BIBL_STAGE_CONVERT:       return "convert";
+		case BIBL_STAGE_CITEKEYS:      return "citekeys";
+		case BIBL_STAGE_WRITECHARSETS: return "writecharsets";
+		case BIBL_STAGE_ASSEMBLE:      return "assemble";
+		case BIBL_STAGE_WRITE:         return "write";
+		default:                       return "unknown";
+	}
+}
+
+void
+bibl_reportstats( FILE *fp, param *p )
+{
+	bibl_stats s;
+	int i;
+
+	bibl_getstats( p, &s );
+	for ( i=0; i<BIBL_NSTAGES; ++i )
+		fprintf( fp, "%-14s %10.6f s %10ld refs\n", bibl_stagename( i ),
+			s.seconds[i], s.nrefs[i] );
+	fprintf( fp, "%-14s %10ld bytes\n", "input",  s.bytesin );
+	fprintf( fp, "%-14s %10ld bytes\n", "output", s.bytesout );
+}
+
 static int
 bibl_illegalinmode( int mode )
 {
@@ -366,9 +500,23 @@ static int
 process_defaultadd( fields *f, int reftype, param *r )
 {
 	int i, n, process, level, status, ret = BIBL_OK;
+	variants *v = &(r->all[reftype]);
+	reftypes_add *a;
 	str tag, value;
 	char *p;
 
+	/* lists split up front by reftypes_index() */
+	if ( v->indexed==1 ) {
+		for ( i=0; i<v->ndefaults; ++i ) {
+			a = &(v->defaults[i]);
+			n = fields_find( f, a->tag, a->level );
+			if ( n!=FIELDS_NOTFOUND ) continue;
+			status = fields_add( f, a->tag, a->value, a->level );
+			if ( status!=FIELDS_OK ) return BIBL_ERR_MEMERR;
+		}
+		return BIBL_OK;
+	}
+
 	strs_init( &tag, &value, NULL );
 
 	for ( i=0; i<r->all[reftype].ntags; ++i ) {
@@ -411,9 +559,20 @@ static int
 process_alwaysadd( fields *f, int reftype, param *r )
 {
 	int i, process, level, status, ret = BIBL_OK;
+	variants *v = &(r->all[reftype]);
+	reftypes_add *a;
 	str tag, value;
 	char *p;
 
+	if ( v->indexed==1 ) {
+		for ( i=0; i<v->nalways; ++i ) {
+			a = &(v->always[i]);
+			status = fields_add( f, a->tag, a->value, a->level );
+			if ( status!=FIELDS_OK ) return BIBL_ERR_MEMERR;
+		}
+		return BIBL_OK;
+	}
+
 	strs_init( &tag, &value, NULL );
 
 	for ( i=0; i<r->all[reftype].ntags; ++i ) {
@@ -443,19 +602,189 @@ out:
 	return ret;
 }
 
+/* read_charset()
+ *
+ * charset from file takes priority over default, but
+ * not user-specified
+ */
+static void
+read_charset( param *p, int fcharset )
+{
+	if ( fcharset==CHARSET_UNKNOWN ) return;
+	if ( p->charsetin_src==BIBL_SRC_USER ) return;
+
+	p->charsetin_src = BIBL_SRC_FILE;
+	p->charsetin = fcharset;
+	if ( fcharset!=CHARSET_UNICODE ) p->utf8in = 0;
+}
+
+/* bibl_input
+ *
+ * Where read_refs() and bibl_convert_stream() take references from.
+ * The readers here take an inbuf (p->readbuf), while a reader set by
+ * the caller in p->readf gets the stream and a buffer for fgets(), as
+ * in earlier releases.
+ */
+typedef struct bibl_input {
+	inbuf in;
+	FILE  *fp;      /* NULL for a memory buffer read by p->readbuf */
+	int   closefp;  /* fp was opened on a memory buffer */
+	char  *buf;
+	int   bufpos;
+	long  start;
+} bibl_input;
+
+static int
+bibl_input_initfp( bibl_input *bi, FILE *fp, param *p )
+{
+	bi->fp      = fp;
+	bi->closefp = 0;
+	bi->buf     = NULL;
+	bi->bufpos  = 0;
+	bi->start   = bibl_streampos( fp );
+
+	if ( !p->readf ) {
+		if ( inbuf_init( &(bi->in), fp )!=INBUF_OK ) return BIBL_ERR_MEMERR;
+		return BIBL_OK;
+	}
+
+	inbuf_initmem( &(bi->in), NULL, 0 );
+
+	bi->buf = ( char * ) malloc( BIBL_READBUFSIZE );
+	if ( !bi->buf ) return BIBL_ERR_MEMERR;
+	bi->buf[0] = '\0';
+
+	return BIBL_OK;
+}
+
+#ifdef WIN32
+static FILE *
+bibl_memopen_read( const char *buf, size_t len )
+{
+	FILE *fp = tmpfile();
+	if ( !fp ) return NULL;
+	if ( fwrite( buf, 1, len, fp )!=len ) {
+		fclose( fp );
+		return NULL;
+	}
+	rewind( fp );
+	return fp;
+}
+#else
+static FILE *
+bibl_memopen_read( const char *buf, size_t len )
+{
+	return fmemopen( ( void * ) buf, len, "r" );
+}
+#endif
+
+static int
+bibl_input_initmem( bibl_input *bi, const char *buf, size_t len, param *p )
+{
+	FILE *fp;
+	int status;
+
+	/* fmemopen() may refuse a zero-length buffer, and with nothing to
+	 * read p->readf need not be called at all */
+	if ( !p->readf || len==0 ) {
+		bi->fp      = NULL;
+		bi->closefp = 0;
+		bi->buf     = NULL;
+		bi->bufpos  = 0;
+		bi->start   = 0;
+		inbuf_initmem( &(bi->in), buf, len );
+		return BIBL_OK;
+	}
+
+	fp = bibl_memopen_read( buf, len );
+	if ( !fp ) return BIBL_ERR_MEMERR;
+
+	status = bibl_input_initfp( bi, fp, p );
+	bi->closefp = 1;
+
+	return status;
+}
+
+static void
+bibl_input_free( bibl_input *bi )
+{
+	inbuf_free( &(bi->in) );
+	if ( bi->buf ) free( bi->buf );
+	if ( bi->closefp ) fclose( bi->fp );
+	bi->buf = NULL;
+	bi->fp  = NULL;
+	bi->closefp = 0;
+}
+
+static int
+bibl_input_next( bibl_input *bi, param *p, str *line, str *reference, int *fcharset )
+{
+	if ( p->readf ) {
+		if ( !bi->fp ) return 0;
+		return p->readf( bi->fp, bi->buf, BIBL_READBUFSIZE, &(bi->bufpos), line, reference, fcharset );
+	} else
+		return p->readbuf( &(bi->in), line, reference, fcharset );
+}
+
+/* bibl_input_nread()
+ *
+ * Returns the bytes read so far, or 0 for a stream that isn't seekable
+ * under p->readf.
+ */
+static long
+bibl_input_nread( bibl_input *bi )
+{
+	long pos;
+
+	if ( !bi->buf ) return ( long ) inbuf_nread( &(bi->in) );
+
+	pos = bibl_streampos( bi->fp );
+	if ( bi->start < 0 || pos < bi->start ) return 0;
+	return pos - bi->start;
+}
+
+/* bibl_input_rewind()
+ *
+ * Go back to where the input started, so that it can be read again.
+ * Only for streams that can be seeked, see bibl_input_seekable().
+ */
+static int
+bibl_input_seekable( bibl_input *bi )
+{
+	return ( bi->fp && bi->start >= 0 );
+}
+
+static int
+bibl_input_rewind( bibl_input *bi )
+{
+	if ( !bibl_input_seekable( bi ) ) return BIBL_ERR_BADINPUT;
+
+	if ( bi->buf ) {
+		if ( fseek( bi->fp, bi->start, SEEK_SET ) ) return BIBL_ERR_CANTOPEN;
+		bi->buf[0] = '\0';
+		bi->bufpos = 0;
+		return BIBL_OK;
+	}
+
+	inbuf_free( &(bi->in) );
+	if ( fseek( bi->fp, bi->start, SEEK_SET ) ) return BIBL_ERR_CANTOPEN;
+	if ( inbuf_init( &(bi->in), bi->fp )!=INBUF_OK ) return BIBL_ERR_MEMERR;
+
+	return BIBL_OK;
+}
+
 static int
-read_refs( FILE *fp, bibl *bin, char *filename, param *p )
+read_refs( bibl_input *in, bibl *bin, char *filename, param *p )
 {
-	int refnum = 0, bufpos = 0, ret=BIBL_OK, fcharset;/* = CHARSET_UNKNOWN;*/
+	int refnum = 0, ret=BIBL_OK, fcharset;/* = CHARSET_UNKNOWN;*/
 	str reference, line;
-	char buf[256]="";
 	fields *ref;
 
 	str_init( &reference );
 	str_init( &line );
-	while ( p->readf( fp, buf, sizeof(buf), &bufpos, &line, &reference, &fcharset ) ) {
+	while ( bibl_input_next( in, p, &line, &reference, &fcharset ) ) {
 		if ( reference.len==0 ) continue;
-		ref = fields_new();
+		ref = bibl_newref( bin );
 		if ( !ref ) {
 			ret = BIBL_ERR_MEMERR;
 			bibl_free( bin );
@@ -464,8 +793,8 @@ read_refs( FILE *fp, bibl *bin, char *filename, param *p )
 		if ( p->processf( ref, reference.data, filename, refnum+1, p )){
 			ret = bibl_addref( bin, ref );
 			if ( ret!=BIBL_OK ) {
-				bibl_free( bin );
 				fields_delete( ref );
+				bibl_free( bin );
 				goto out;
 			}
 			refnum += 1;
@@ -473,15 +802,12 @@ read_refs( FILE *fp, bibl *bin, char *filename, param *p )
 			fields_delete( ref );
 		}
 		str_empty( &reference );
-		if ( fcharset!=CHARSET_UNKNOWN ) {
-			/* charset from file takes priority over default, but
-			 * not user-specified */
-			if ( p->charsetin_src!=BIBL_SRC_USER ) {
-				p->charsetin_src = BIBL_SRC_FILE;
-				p->charsetin = fcharset;
-				if ( fcharset!=CHARSET_UNICODE ) p->utf8in = 0;
-			}
-		}
+		read_charset( p, fcharset );
+	}
+	if ( in->in.status!=INBUF_OK ) {
+		ret = BIBL_ERR_MEMERR;
+		bibl_free( bin );
+		goto out;
 	}
 	if ( p->charsetin==CHARSET_UNICODE ) p->utf8in = 1;
 out:
@@ -501,12 +827,24 @@ bibl_notexify( char *tag )
 	return 0;
 }
 
-/* bibl_fixcharsetdata()
+/* bibl_fixcharsets_init()
  *
- * returns BIBL_OK or BIBL_ERR_MEMERR
+ * Set up the converters for fields that may be texified and for those
+ * that may not (see bibl_notexify()).
  */
+static void
+bibl_fixcharsets_init( str_converter *tex, str_converter *notex, param *p )
+{
+	str_converter_init( tex,
+		p->charsetin,  p->latexin,  p->utf8in,  p->xmlin,
+		p->charsetout, p->latexout, p->utf8out, p->xmlout );
+	str_converter_init( notex,
+		p->charsetin,  0, p->utf8in,  p->xmlin,
+		p->charsetout, 0, p->utf8out, p->xmlout );
+}
+
 static int
-bibl_fixcharsetdata( fields *ref, param *p )
+bibl_fixcharsetref( fields *ref, str_converter *tex, str_converter *notex )
 {
 	str *data;
 	char *tag;
@@ -520,15 +858,8 @@ bibl_fixcharsetdata( fields *ref, param *p )
 		tag  = fields_tag( ref, i, FIELDS_CHRP_NOUSE );
 		data = fields_value( ref, i, FIELDS_STRP_NOUSE );
 
-		if ( bibl_notexify( tag ) ) {
-			ok = str_convert( data,
-				p->charsetin,  0, p->utf8in,  p->xmlin,
-				p->charsetout, 0, p->utf8out, p->xmlout );
-		} else {
-			ok = str_convert( data,
-				p->charsetin,  p->latexin,  p->utf8in,  p->xmlin,
-				p->charsetout, p->latexout, p->utf8out, p->xmlout );
-		}
+		if ( bibl_notexify( tag ) ) ok = str_converter_apply( notex, data );
+		else ok = str_converter_apply( tex, data );
 
 		if ( !ok ) return BIBL_ERR_MEMERR;
 	}
@@ -543,11 +874,14 @@ bibl_fixcharsetdata( fields *ref, param *p )
 static int
 bibl_fixcharsets( bibl *b, param *p )
 {
+	str_converter tex, notex;
 	int status;
 	long i;
 
+	bibl_fixcharsets_init( &tex, &notex, p );
+
 	for ( i=0; i<b->n; ++i ) {
-		status = bibl_fixcharsetdata( b->ref[i], p );
+		status = bibl_fixcharsetref( b->ref[i], &tex, &notex );
 		if ( status!=BIBL_OK ) return status;
 	}
 
@@ -555,26 +889,32 @@ bibl_fixcharsets( bibl *b, param *p )
 }
 
 static int
-bibl_addcount( bibl *b )
+bibl_addcountref( fields *ref, long nref )
 {
 	char buf[512];
-	fields *ref;
-	long i;
 	int n;
 
-	for ( i=0; i<b->n; ++i ) {
+	n = fields_find( ref, "REFNUM", LEVEL_MAIN );
+	if ( n==FIELDS_NOTFOUND ) return BIBL_OK;
 
-		ref = b->ref[i];
+	sprintf( buf, "_%ld", nref );
+	str_strcatc( fields_value( ref, n, FIELDS_STRP_NOUSE ), buf );
+	if ( str_memerr( fields_value( ref, n, FIELDS_STRP_NOUSE ) ) ) {
+		return BIBL_ERR_MEMERR;
+	}
 
-		n = fields_find( ref, "REFNUM", LEVEL_MAIN );
-		if ( n==FIELDS_NOTFOUND ) continue;
+	return BIBL_OK;
+}
 
-		sprintf( buf, "_%ld", i+1 );
-		str_strcatc( fields_value( ref, n, FIELDS_STRP_NOUSE ), buf );
-		if ( str_memerr( fields_value( ref, n, FIELDS_STRP_NOUSE ) ) ) {
-			return BIBL_ERR_MEMERR;
-		}
+static int
+bibl_addcount( bibl *b )
+{
+	int status;
+	long i;
 
+	for ( i=0; i<b->n; ++i ) {
+		status = bibl_addcountref( b->ref[i], i+1 );
+		if ( status!=BIBL_OK ) return status;
 	}
 
 	return BIBL_OK;
@@ -662,23 +1002,34 @@ get_citekeys( bibl *bin, slist *citekeys )
 	return BIBL_OK;
 }
 
+/* identify_duplicates()
+ *
+ * Mark every reference whose citekey occurs more than once with the
+ * position of the first reference carrying that citekey.
+ *
+ * Returns the number of duplicates or -1 on memory error.
+ */
 static int
 identify_duplicates( bibl *b, slist *citekeys, int *dup )
 {
-	int i, j, ndup = 0;
+	int i, first, status, ndup = 0;
+	strhash seen;
 
-	for ( i=0; i<citekeys->n-1; ++i ) {
-		if ( dup[i]!=-1 ) continue;
-		for ( j=i+1; j<citekeys->n; ++j ) {
-			if ( !strcmp( slist_cstr( citekeys, i ),
-			              slist_cstr( citekeys, j ) ) ) {
-					dup[i] = i;
-					dup[j] = i;
-					ndup++;
-			}
+	strhash_init( &seen, STRHASH_CASE );
+
+	for ( i=0; i<citekeys->n; ++i ) {
+		first = strhash_find( &seen, slist_cstr( citekeys, i ) );
+		if ( first==STRHASH_NOTFOUND ) {
+			status = strhash_add( &seen, slist_cstr( citekeys, i ), i );
+			if ( status!=STRHASH_OK ) { ndup = -1; goto out; }
+		} else {
+			dup[first] = first;
+			dup[i]     = first;
+			ndup++;
 		}
 	}
-
+out:
+	strhash_free( &seen );
 	return ndup;
 }
 
@@ -699,42 +1050,42 @@ build_new_citekey( int nsame, str *old_citekey, str *new_citekey )
 	return ( str_memerr( new_citekey ) ) ? BIBL_ERR_MEMERR : BIBL_OK;
 }
 
+/* resolve_duplicates()
+ *
+ * Append "a", "b", ... to duplicated citekeys in reference order,
+ * counting separately for each set of duplicates.
+ */
 static int
 resolve_duplicates( bibl *b, slist *citekeys, int *dup )
 {
-	int nsame, n, i, j, status = BIBL_OK;
+	int n, j, *nsame, status = BIBL_OK;
 	str new_citekey, *ref_citekey;
 
-	str_init( &new_citekey );
-
-	for ( i=0; i<citekeys->n; ++i ) {
-
-		if ( dup[i]==-1 ) continue;
-
-		nsame = 0;
+	nsame = ( int * ) calloc( citekeys->n, sizeof( int ) );
+	if ( !nsame ) return BIBL_ERR_MEMERR;
 
-		for ( j=i; j<citekeys->n; ++j ) {
+	str_init( &new_citekey );
 
-			if ( dup[j]!=i ) continue;
+	for ( j=0; j<citekeys->n; ++j ) {
 
-			dup[j] = -1;
+		if ( dup[j]==-1 ) continue;
 
-			status = build_new_citekey( nsame, slist_str( citekeys, j ), &new_citekey );
-			if ( status!=BIBL_OK ) goto out;
+		status = build_new_citekey( nsame[dup[j]], slist_str( citekeys, j ), &new_citekey );
+		if ( status!=BIBL_OK ) goto out;
 
-			n = fields_find( b->ref[j], "REFNUM", LEVEL_ANY );
-			if ( n==FIELDS_NOTFOUND ) continue;
+		n = fields_find( b->ref[j], "REFNUM", LEVEL_ANY );
+		if ( n==FIELDS_NOTFOUND ) continue;
 
-			ref_citekey = fields_value( b->ref[j], n, FIELDS_STRP_NOUSE );
+		ref_citekey = fields_value( b->ref[j], n, FIELDS_STRP_NOUSE );
 
-			str_strcpy( ref_citekey, &new_citekey );
-			if ( str_memerr( ref_citekey ) ) { status = BIBL_ERR_MEMERR; goto out; }
+		str_strcpy( ref_citekey, &new_citekey );
+		if ( str_memerr( ref_citekey ) ) { status = BIBL_ERR_MEMERR; goto out; }
 
-			nsame++;
-		}
+		nsame[dup[j]]++;
 	}
 out:
 	str_free( &new_citekey );
+	free( nsame );
 	return status;
 }
 
@@ -749,7 +1100,8 @@ identify_and_resolve_duplicate_citekeys( bibl *b, slist *citekeys )
 
 	ndup = identify_duplicates( b, citekeys, dup );
 
-	if ( ndup ) status = resolve_duplicates( b, citekeys, dup );
+	if ( ndup==-1 ) status = BIBL_ERR_MEMERR;
+	else if ( ndup ) status = resolve_duplicates( b, citekeys, dup );
 
 	free( dup );
 	return status;
@@ -779,119 +1131,327 @@ clean_refs( bibl *bin, param *p )
 	else return BIBL_OK;
 }
 
-static int 
-convert_refs( bibl *bin, char *fname, bibl *bout, param *p )
+/* convert_ref()
+ *
+ * Convert a single reference from the input format's tags to
+ * the internal representation.
+ *
+ * returns BIBL_OK or BIBL_ERR_MEMERR
+ */
+static int
+convert_ref( fields *rin, char *fname, long nref, fields *rout, param *p )
 {
 	int reftype = 0, status;
-	fields *rin, *rout;
-	long i;
 
-	for ( i=0; i<bin->n; ++i ) {
-
-		rin = bin->ref[i];
+	if ( p->typef ) reftype = p->typef( rin, fname, nref, p );
 
-		rout = fields_new();
-		if ( !rout ) return BIBL_ERR_MEMERR;
-
-		if ( p->typef ) reftype = p->typef( rin, fname, i+1, p );
+	status = p->convertf( rin, rout, reftype, p );
+	if ( status!=BIBL_OK ) return status;
 
-		status = p->convertf( rin, rout, reftype, p );
+	if ( p->all ) {
+		status = process_alwaysadd( rout, reftype, p );
 		if ( status!=BIBL_OK ) return status;
-
-		if ( p->all ) {
-			status = process_alwaysadd( rout, reftype, p );
-			if ( status!=BIBL_OK ) return status;
-			status = process_defaultadd( rout, reftype, p );
-			if ( status!=BIBL_OK ) return status;
-		}
-
-		status = bibl_addref( bout, rout );
+		status = process_defaultadd( rout, reftype, p );
 		if ( status!=BIBL_OK ) return status;
 	}
 
 	return BIBL_OK;
 }
 
-int
-bibl_read( bibl *b, FILE *fp, char *filename, param *p )
+/* Worker pool
+ *
+ * bibl_parallel() calls fn( i, data ) once for every i in [0,n) using
+ * up to nthreads threads (the calling thread included). Indices are
+ * handed out in increasing order, so fn only has to be safe for
+ * distinct i. Once an index fails no further indices are started, and
+ * the status of the lowest failing index is returned, so errors are
+ * reported the same way however the work was scheduled.
+ *
+ * With nthreads<=1 this is a plain serial loop.
+ */
+typedef int (*bibl_workf)( long i, void *data );
+
+typedef struct workpool {
+	bu_mutex_t lock;
+	long next;
+	long n;
+	long failed;   /* lowest failing index, n if none */
+	int status;
+	bibl_workf fn;
+	void *data;
+} workpool;
+
+static void *
+workpool_run( void *arg )
 {
-	int status = BIBL_OK;
-	param read_params;
-	bibl bin;
+	workpool *w = ( workpool * ) arg;
+	int status;
+	long i;
 
-	if ( !b )  return BIBL_ERR_BADINPUT;
-	if ( !fp ) return BIBL_ERR_BADINPUT;
-	if ( !p )  return BIBL_ERR_BADINPUT;
+	while ( 1 ) {
 
-	if ( bibl_illegalinmode( p->readformat ) ) {
-		if ( debug_set( p ) ) report_params( stderr, "bibl_read", p );
-		return BIBL_ERR_BADINPUT;
-	}
+		bu_mutex_lock( &(w->lock) );
+		if ( w->next < w->failed ) i = w->next++;
+		else i = w->n;
+		bu_mutex_unlock( &(w->lock) );
 
-	status = bibl_setreadparams( &read_params, p );
-	if ( status!=BIBL_OK ) {
-		if ( debug_set( p ) ) report_params( stderr, "bibl_read", p );
-		return status;
-	}
+		if ( i >= w->n ) break;
 
-	if ( debug_set( &read_params ) ) {
-		report_params( stderr, "bibl_read", &read_params );
+		status = w->fn( i, w->data );
+		if ( status!=BIBL_OK ) {
+			bu_mutex_lock( &(w->lock) );
+			if ( i < w->failed ) {
+				w->failed = i;
+				w->status = status;
+			}
+			bu_mutex_unlock( &(w->lock) );
+		}
 	}
 
-	bibl_init( &bin );
+	return NULL;
+}
 
-	status = read_refs( fp, &bin, filename, &read_params );
-	if ( status!=BIBL_OK ) {
-		if ( debug_set( &read_params ) ) report_params( stderr, "bibl_read", &read_params );
-		bibl_freeparams( &read_params );
-		return status;
-	}
+static int
+bibl_parallel( long n, int nthreads, bibl_workf fn, void *data )
+{
+	bu_thread_t *threads;
+	int i, nstarted;
+	workpool w;
+	long j;
 
-	if ( debug_set( &read_params ) ) {
-		bibl_verbose( &bin, "raw_input", "for bibl_read" );
-	}
+	if ( nthreads > n ) nthreads = n;
 
-	if ( !read_params.output_raw ) {
-		status = clean_refs( &bin, &read_params );
-		if ( status!=BIBL_OK ) goto out;
-		if ( debug_set( &read_params ) ) bibl_verbose( &bin, "post_clean_refs", "for bibl_read" );
+	if ( nthreads <= 1 ) {
+		for ( j=0; j<n; ++j ) {
+			w.status = fn( j, data );
+			if ( w.status!=BIBL_OK ) return w.status;
+		}
+		return BIBL_OK;
 	}
 
-	if ( ( !read_params.output_raw ) || ( read_params.output_raw & BIBL_RAW_WITHCHARCONVERT ) ) {
-		status = bibl_fixcharsets( &bin, &read_params );
-		if ( status!=BIBL_OK ) goto out;
-		if ( debug_set( &read_params ) ) bibl_verbose( &bin, "post_fixcharsets", "for bibl_read" );
-	}
+	threads = ( bu_thread_t * ) malloc( sizeof( bu_thread_t ) * ( nthreads - 1 ) );
+	if ( !threads ) return BIBL_ERR_MEMERR;
 
-	if ( !read_params.output_raw ) {
-		status = convert_refs( &bin, filename, b, &read_params );
-		if ( status!=BIBL_OK ) goto out;
-		if ( debug_set( &read_params ) ) bibl_verbose( b, "post_convert_refs", "for bibl_read" );
+	if ( bu_mutex_init( &(w.lock) ) ) {
+		free( threads );
+		return BIBL_ERR_MEMERR;
 	}
-
-	else {
-		status = bibl_copy( b, &bin );
-		if ( status!=BIBL_OK ) goto out;
-		if ( debug_set( &read_params ) ) bibl_verbose( b, "post_bibl_copy", "for bibl_read" );
+	w.next   = 0;
+	w.n      = n;
+	w.failed = n;
+	w.status = BIBL_OK;
+	w.fn     = fn;
+	w.data   = data;
+
+	/* if a thread can't be started, the ones we have do its share */
+	nstarted = 0;
+	for ( i=0; i<nthreads-1; ++i ) {
+		if ( bu_thread_create( &(threads[nstarted]), workpool_run, &w ) ) break;
+		nstarted++;
 	}
 
-	if ( ( !read_params.output_raw ) || ( read_params.output_raw & BIBL_RAW_WITHMAKEREFID ) ) {
-		status = uniqueify_citekeys( b );
-		if ( status!=BIBL_OK ) goto out;
-		if ( read_params.addcount ) {
-			status = bibl_addcount( b );
-			if ( status!=BIBL_OK ) goto out;
+	workpool_run( &w );
+
+	for ( i=0; i<nstarted; ++i )
+		bu_thread_join( threads[i] );
+
+	bu_mutex_free( &(w.lock) );
+	free( threads );
+
+	return w.status;
+}
+
+typedef struct convertjob {
+	bibl  *bin;
+	bibl  *bout;
+	long   first;   /* position in bout of the result for bin->ref[0] */
+	char  *fname;
+	param *p;
+} convertjob;
+
+static int
+convert_refs_one( long i, void *data )
+{
+	convertjob *job = ( convertjob * ) data;
+
+	return convert_ref( job->bin->ref[i], job->fname, i+1, job->bout->ref[job->first+i], job->p );
+}
+
+/* convert_refs_drop()
+ *
+ * Remove the references convert_refs() appended to b from position
+ * first on, filled or not.
+ */
+static void
+convert_refs_drop( bibl *b, long first )
+{
+	while ( b->n > first ) {
+		b->n--;
+		fields_delete( b->ref[b->n] );
+		b->ref[b->n] = NULL;
+	}
+	bibl_clearindex( b );
+}
+
+/* convert_refs()
+ *
+ * An empty output reference is appended to bout for every input
+ * reference before any conversion starts, so that with p->nthreads>1
+ * each worker fills its own slot and the output order doesn't depend
+ * on scheduling. On error all of them are removed again, so bout
+ * is left as it was.
+ */
+static int
+convert_refs( bibl *bin, char *fname, bibl *bout, param *p )
+{
+	convertjob job;
+	fields *rout;
+	int status;
+	long i;
+
+	job.bin   = bin;
+	job.bout  = bout;
+	job.first = bout->n;
+	job.fname = fname;
+	job.p     = p;
+
+	for ( i=0; i<bin->n; ++i ) {
+
+		rout = bibl_newref( bout );
+		if ( !rout ) {
+			status = BIBL_ERR_MEMERR;
+			goto out;
+		}
+
+		status = bibl_addref( bout, rout );
+		if ( status!=BIBL_OK ) {
+			fields_delete( rout );
+			goto out;
 		}
+	}
+
+	status = bibl_parallel( bin->n, p->nthreads, convert_refs_one, &job );
+out:
+	if ( status!=BIBL_OK ) convert_refs_drop( bout, job.first );
+	return status;
+}
+
+static int
+bibl_readin( bibl *b, bibl_input *in, char *filename, param *p )
+{
+	int status = BIBL_OK;
+	param read_params;
+	long nread;
+	double start;
+	long nstart;
+	bibl bin;
+
+	if ( !b )  return BIBL_ERR_BADINPUT;
+	if ( !p )  return BIBL_ERR_BADINPUT;
+
+	if ( bibl_illegalinmode( p->readformat ) ) {
+		if ( debug_set( p ) ) report_params( stderr, "bibl_read", p );
+		return BIBL_ERR_BADINPUT;
+	}
+
+	status = bibl_setreadparams( &read_params, p );
+	if ( status!=BIBL_OK ) {
+		if ( debug_set( p ) ) report_params( stderr, "bibl_read", p );
+		return status;
+	}
+
+	if ( debug_set( &read_params ) ) {
+		report_params( stderr, "bibl_read", &read_params );
+	}
+
+	/* bin is thrown away whole at the end, so an arena only saves time;
+	 * it costs memory, as nothing in it is freed before then */
+	if ( read_params.usearena ) {
+		status = bibl_initarena( &bin );
+		if ( status!=BIBL_OK ) goto out;
+	}
+	else bibl_init( &bin );
+
+	start = bibl_clock();
+	nread = bibl_input_nread( in );
+	status = read_refs( in, &bin, filename, &read_params );
+	read_params.stats.bytesin += bibl_input_nread( in ) - nread;
+	bibl_stagedone( &read_params, BIBL_STAGE_READ, start, bin.n );
+	if ( status!=BIBL_OK ) {
+		if ( debug_set( &read_params ) ) report_params( stderr, "bibl_read", &read_params );
+		goto out;
+	}
+
+	if ( debug_set( &read_params ) ) {
+		bibl_verbose( &bin, "raw_input", "for bibl_read" );
+	}
+
+	if ( !read_params.output_raw ) {
+		start = bibl_clock();
+		status = clean_refs( &bin, &read_params );
+		bibl_stagedone( &read_params, BIBL_STAGE_CLEAN, start, bin.n );
+		if ( status!=BIBL_OK ) goto out;
+		if ( debug_set( &read_params ) ) bibl_verbose( &bin, "post_clean_refs", "for bibl_read" );
+	}
+
+	if ( ( !read_params.output_raw ) || ( read_params.output_raw & BIBL_RAW_WITHCHARCONVERT ) ) {
+		start = bibl_clock();
+		status = bibl_fixcharsets( &bin, &read_params );
+		bibl_stagedone( &read_params, BIBL_STAGE_READCHARSETS, start, bin.n );
+		if ( status!=BIBL_OK ) goto out;
+		if ( debug_set( &read_params ) ) bibl_verbose( &bin, "post_fixcharsets", "for bibl_read" );
+	}
+
+	if ( !read_params.output_raw ) {
+		start = bibl_clock();
+		nstart = b->n;
+		status = convert_refs( &bin, filename, b, &read_params );
+		bibl_stagedone( &read_params, BIBL_STAGE_CONVERT, start, b->n - nstart );
+		if ( status!=BIBL_OK ) goto out;
+		if ( debug_set( &read_params ) ) bibl_verbose( b, "post_convert_refs", "for bibl_read" );
+	}
+
+	else {
+		status = bibl_copy( b, &bin );
+		if ( status!=BIBL_OK ) goto out;
+		if ( debug_set( &read_params ) ) bibl_verbose( b, "post_bibl_copy", "for bibl_read" );
+	}
+
+	if ( ( !read_params.output_raw ) || ( read_params.output_raw & BIBL_RAW_WITHMAKEREFID ) ) {
+		start = bibl_clock();
+		status = uniqueify_citekeys( b );
+		bibl_clearindex( b );
+		if ( status==BIBL_OK && read_params.addcount )
+			status = bibl_addcount( b );
+		bibl_stagedone( &read_params, BIBL_STAGE_CITEKEYS, start, b->n );
+		if ( status!=BIBL_OK ) goto out;
 		if ( debug_set( &read_params ) ) bibl_verbose( &bin, "post_uniqueify_citekeys", "for bibl_read" );
 	}
 
 out:
+	bibl_addstats( p, &(read_params.stats) );
 	bibl_free( &bin );
 	bibl_freeparams( &read_params );
 
 	return status;
 }
 
+int
+bibl_read( bibl *b, FILE *fp, char *filename, param *p )
+{
+	bibl_input in;
+	int status;
+
+	if ( !fp ) return BIBL_ERR_BADINPUT;
+	if ( !p )  return BIBL_ERR_BADINPUT;
+
+	status = bibl_input_initfp( &in, fp, p );
+	if ( status==BIBL_OK ) status = bibl_readin( b, &in, filename, p );
+	bibl_input_free( &in );
+
+	return status;
+}
+
 static FILE *
 singlerefname( fields *reffields, long nref, int mode )
 {
@@ -930,6 +1490,7 @@ static int
 bibl_writeeachfp( FILE *fp, bibl *b, param *p )
 {
 	fields out, *use = &out;
+	double start;
 	int status;
 	long i;
 
@@ -940,19 +1501,26 @@ bibl_writeeachfp( FILE *fp, bibl *b, param *p )
 		fp = singlerefname( b->ref[i], i, p->writeformat );
 		if ( !fp ) return BIBL_ERR_CANTOPEN;
 
+		start = bibl_clock();
 		if ( p->headerf ) p->headerf( fp, p );
+		bibl_stagedone( p, BIBL_STAGE_WRITE, start, 0 );
 
 		if ( p->assemblef ) {
+			start = bibl_clock();
 			fields_free( &out );
 			status = p->assemblef( b->ref[i], &out, p, i );
+			bibl_stagedone( p, BIBL_STAGE_ASSEMBLE, start, 1 );
 			if ( status!=BIBL_OK ) break;
 		} else {
 			use = b->ref[i];
 		}
 
+		start = bibl_clock();
 		status = p->writef( use, fp, p, i );
-
 		if ( p->footerf ) p->footerf( fp );
+		bibl_stagedone( p, BIBL_STAGE_WRITE, start, 1 );
+
+		bibl_addbytes( &(p->stats.bytesout), 0, bibl_streampos( fp ) );
 		fclose( fp );
 
 		if ( status!=BIBL_OK ) return status;
@@ -961,11 +1529,122 @@ bibl_writeeachfp( FILE *fp, bibl *b, param *p )
 	return BIBL_OK;
 }
 
+/* bibl_writeref()
+ *
+ * Assemble (if the output format requires it) and write a single reference.
+ */
+static int
+bibl_writeref( FILE *fp, fields *ref, fields *out, param *p, long nref )
+{
+	double start;
+	int status;
+
+	if ( p->assemblef ) {
+		start = bibl_clock();
+		fields_free( out );
+		status = p->assemblef( ref, out, p, nref );
+		bibl_stagedone( p, BIBL_STAGE_ASSEMBLE, start, 1 );
+		if ( status!=BIBL_OK ) return status;
+		if ( debug_set( p ) ) bibl_verbose_reference( out, "", nref+1 );
+		ref = out;
+	}
+
+	start = bibl_clock();
+	status = p->writef( ref, fp, p, nref );
+	bibl_stagedone( p, BIBL_STAGE_WRITE, start, 1 );
+
+	return status;
+}
+
+/* Parallel assembly
+ *
+ * With p->nthreads>1, references are assembled a batch at a time on
+ * the worker pool, each into its own fields, and then written in order
+ * by the calling thread, so the output is identical to assembling
+ * serially. Working in batches bounds the number of assembled copies
+ * held at once.
+ */
+#define BIBL_ASSEMBLE_BATCH (64)  /* references per thread per batch */
+
+typedef struct assemblejob {
+	bibl   *b;
+	long    first;   /* position in b of out[0] */
+	fields *out;
+	int    *status;
+	param  *p;
+} assemblejob;
+
+static int
+assemble_one( long i, void *data )
+{
+	assemblejob *job = ( assemblejob * ) data;
+
+	fields_free( &(job->out[i]) );
+	job->status[i] = job->p->assemblef( job->b->ref[job->first+i], &(job->out[i]), job->p, job->first+i );
+
+	/* the writer reports failures in reference order */
+	return BIBL_OK;
+}
+
+static int
+bibl_writerefs_parallel( FILE *fp, bibl *b, param *p )
+{
+	long i, n, nbatch;
+	int status = BIBL_OK;
+	assemblejob job;
+	double start;
+
+	nbatch = ( long ) p->nthreads * BIBL_ASSEMBLE_BATCH;
+	if ( nbatch > b->n ) nbatch = b->n;
+
+	job.b      = b;
+	job.p      = p;
+	job.out    = ( fields * ) malloc( sizeof( fields ) * nbatch );
+	job.status = ( int * ) malloc( sizeof( int ) * nbatch );
+	if ( !job.out || !job.status ) {
+		status = BIBL_ERR_MEMERR;
+		goto out;
+	}
+
+	for ( i=0; i<nbatch; ++i )
+		fields_init( &(job.out[i]) );
+
+	for ( job.first=0; job.first<b->n && status==BIBL_OK; job.first+=n ) {
+
+		n = b->n - job.first;
+		if ( n > nbatch ) n = nbatch;
+
+		start = bibl_clock();
+		status = bibl_parallel( n, p->nthreads, assemble_one, &job );
+		bibl_stagedone( p, BIBL_STAGE_ASSEMBLE, start, n );
+		if ( status!=BIBL_OK ) break;
+
+		start = bibl_clock();
+		for ( i=0; i<n; ++i ) {
+			status = job.status[i];
+			if ( status!=BIBL_OK ) break;
+			if ( debug_set( p ) ) bibl_verbose_reference( &(job.out[i]), "", job.first+i+1 );
+			status = p->writef( &(job.out[i]), fp, p, job.first+i );
+			if ( status!=BIBL_OK ) break;
+		}
+		bibl_stagedone( p, BIBL_STAGE_WRITE, start, i );
+	}
+
+	for ( i=0; i<nbatch; ++i )
+		fields_free( &(job.out[i]) );
+out:
+	if ( job.out )    free( job.out );
+	if ( job.status ) free( job.status );
+
+	return status;
+}
+
 static int
 bibl_writefp( FILE *fp, bibl *b, param *p )
 {
 	int status = BIBL_OK;
-	fields out, *use = &out;
+	double start;
+	fields out;
 	long i;
 
 	fields_init( &out );
@@ -974,35 +1653,37 @@ bibl_writefp( FILE *fp, bibl *b, param *p )
 		fprintf( stderr, "-------------------assemblef start for bibl_write\n");
 	}
 
+	start = bibl_clock();
 	if ( p->headerf ) p->headerf( fp, p );
-	for ( i=0; i<b->n; ++i ) {
+	bibl_stagedone( p, BIBL_STAGE_WRITE, start, 0 );
 
-		if ( p->assemblef ) {
-			fields_free( &out );
-			status = p->assemblef( b->ref[i], &out, p, i );
+	if ( p->assemblef && p->nthreads > 1 && b->n > 1 ) {
+		status = bibl_writerefs_parallel( fp, b, p );
+	} else {
+		for ( i=0; i<b->n; ++i ) {
+			status = bibl_writeref( fp, b->ref[i], &out, p, i );
 			if ( status!=BIBL_OK ) break;
-			if ( debug_set( p ) ) bibl_verbose_reference( &out, "", i+1 );
-		} else {
-			use = b->ref[i];
 		}
-
-		status = p->writef( use, fp, p, i );
-		if ( status!=BIBL_OK ) break;
-
 	}
 
 	if ( debug_set( p ) && p->assemblef ) {
 		fprintf( stderr, "-------------------assemblef end for bibl_write\n");
 	}
 
+	start = bibl_clock();
 	if ( p->footerf ) p->footerf( fp );
+	bibl_stagedone( p, BIBL_STAGE_WRITE, start, 0 );
+
+	fields_free( &out );
 	return status;
 }
 
 int
 bibl_write( bibl *b, FILE *fp, param *p )
 {
+	double start;
 	int status;
+	long pos;
 	param lp;
 
 	if ( !b ) return BIBL_ERR_BADINPUT;
@@ -1020,15 +1701,910 @@ bibl_write( bibl *b, FILE *fp, param *p )
 
 	if ( debug_set( p ) ) bibl_verbose( b, "raw_input", "for bibl_write" );
 
+	start = bibl_clock();
 	status = bibl_fixcharsets( b, &lp );
+	bibl_clearindex( b );
+	bibl_stagedone( &lp, BIBL_STAGE_WRITECHARSETS, start, b->n );
 	if ( status!=BIBL_OK ) goto out;
 
 	if ( debug_set( p ) ) bibl_verbose( b, "post-fixcharsets", "for bibl_write" );
 
 	if ( p->singlerefperfile ) status = bibl_writeeachfp( fp, b, &lp );
-	else status = bibl_writefp( fp, b, &lp );
+	else {
+		pos = bibl_streampos( fp );
+		status = bibl_writefp( fp, b, &lp );
+		bibl_addbytes( &(lp.stats.bytesout), pos, bibl_streampos( fp ) );
+	}
 
 out:
+	bibl_addstats( p, &(lp.stats) );
 	bibl_freeparams( &lp );
 	return status;
 }
+
+/* Memory buffers
+ *
+ * bibl_read_mem() reads references from len bytes at buf, which the
+ * readers scan in place (a p->readf set by the caller reads it through
+ * a stdio memory stream instead). bibl_write_mem() writes them into a buffer
+ * allocated with malloc(), which is returned in *buf (with its length
+ * in *len) and must be released by the caller with free(); it goes
+ * through the same FILE*-based writers as bibl_write(), using a stdio
+ * memory stream, or a temporary file where these aren't available.
+ */
+int
+bibl_read_mem( bibl *b, const char *buf, size_t len, char *filename, param *p )
+{
+	bibl_input in;
+	int status;
+
+	if ( !buf && len ) return BIBL_ERR_BADINPUT;
+	if ( !p ) return BIBL_ERR_BADINPUT;
+
+	status = bibl_input_initmem( &in, buf, len, p );
+	if ( status==BIBL_OK ) status = bibl_readin( b, &in, filename, p );
+	bibl_input_free( &in );
+
+	return status;
+}
+
+#ifdef WIN32
+int
+bibl_write_mem( bibl *b, char **buf, size_t *len, param *p )
+{
+	int status;
+	long size;
+	FILE *fp;
+
+	if ( !buf || !len ) return BIBL_ERR_BADINPUT;
+	*buf = NULL;
+	*len = 0;
+	if ( p && p->singlerefperfile ) return BIBL_ERR_BADINPUT;
+
+	fp = tmpfile();
+	if ( !fp ) return BIBL_ERR_CANTOPEN;
+
+	status = bibl_write( b, fp, p );
+	if ( status!=BIBL_OK ) goto out;
+
+	size = ftell( fp );
+	if ( size < 0 ) {
+		status = BIBL_ERR_CANTOPEN;
+		goto out;
+	}
+
+	*buf = ( char * ) malloc( size + 1 );
+	if ( !*buf ) {
+		status = BIBL_ERR_MEMERR;
+		goto out;
+	}
+
+	rewind( fp );
+	*len = fread( *buf, 1, size, fp );
+	(*buf)[*len] = '\0';
+out:
+	fclose( fp );
+	return status;
+}
+#else
+int
+bibl_write_mem( bibl *b, char **buf, size_t *len, param *p )
+{
+	int status;
+	FILE *fp;
+
+	if ( !buf || !len ) return BIBL_ERR_BADINPUT;
+	*buf = NULL;
+	*len = 0;
+	if ( p && p->singlerefperfile ) return BIBL_ERR_BADINPUT;
+
+	fp = open_memstream( buf, len );
+	if ( !fp ) return BIBL_ERR_MEMERR;
+
+	status = bibl_write( b, fp, p );
+
+	/* buffer and length are only final once the stream is closed */
+	if ( fclose( fp ) && status==BIBL_OK ) status = BIBL_ERR_MEMERR;
+
+	if ( status!=BIBL_OK ) {
+		free( *buf );
+		*buf = NULL;
+		*len = 0;
+	}
+
+	return status;
+}
+#endif
+
+/* Streaming conversion
+ *
+ * bibl_convert_stream() pushes each reference through the read
+ * (processf, cleanf, typef/convertf) and write (assemblef/writef)
+ * stages as soon as it is read, so that at most one reference is
+ * held in memory at a time.
+ *
+ * Two things need more than the reference at hand. Citekeys are made
+ * unique the way uniqueify_citekeys() does it, and whether the first
+ * reference with a citekey gets an "a" depends on references that
+ * come after it. And the cleanf of BibTeX/BibLaTeX resolves crossref
+ * against the other references of the input.
+ *
+ * When the input can be seeked, it is read more than once instead,
+ * see stream_passes(): one pass collects the crossref keys, the next
+ * keeps copies of the (raw) references they point to, another counts
+ * the citekeys and the last one writes each reference as soon as it
+ * is converted. What stays in memory is the count for each citekey,
+ * the crossref keys and the references they point to. Warnings that
+ * the readers give for a reference are given again on each pass that
+ * reads it.
+ *
+ * So BibTeX/BibLaTeX input with a crossref is parsed four times, the
+ * most any input is. Without one, and for the other formats when
+ * citekeys are made, it is parsed twice: one pass counts the citekeys
+ * and the other writes (three times if a character set found part way
+ * through the input means they have to be counted again). Reading is
+ * cheap next to converting, and the references are converted only on
+ * the passes that need them.
+ *
+ * Pipes and the like are read only once: BibTeX/BibLaTeX input is
+ * then read completely, as bibl_read() would, and when citekeys are
+ * made, the converted references are spooled to a temporary file
+ * until the input is done.
+ */
+#define STREAM_KEYS     (1)  /* collect the crossref keys */
+#define STREAM_TARGETS  (2)  /* keep the references they point to */
+#define STREAM_COUNT    (4)  /* count the citekeys */
+#define STREAM_WRITE    (8)  /* write the references */
+#define STREAM_LINKED   (16) /* ... of references with a crossref */
+#define STREAM_UNLINKED (32) /* ... of references without one */
+
+typedef struct stream {
+	param   rp;         /* read parameters */
+	param   wp;         /* write parameters */
+	char   *filename;
+	FILE   *out;
+	int     citekeys_made;
+	int     needsall;   /* cleanf resolves crossref */
+	int     npass;
+	int     recount;    /* the charset changed after citekeys were counted */
+	FILE   *spool;      /* converted references waiting for citekeys */
+	long    nspool;
+	strhash citekeys;   /* times each citekey occurs in the input */
+	strhash written;    /* times each duplicated citekey has been written */
+	strhash crossrefs;  /* the (cleaned) crossref keys */
+	strhash targetkeys; /* crossref key -> index into targets */
+	bibl    targets;    /* raw copies of the references crossrefs point to */
+	intlist targetpos;  /* ... and their reference numbers */
+	str_converter rtex, rnotex; /* see bibl_fixcharsets_init() */
+	str_converter wtex, wnotex;
+	fields  assembled;
+} stream;
+
+static int
+bibl_readformat_needsall( int mode )
+{
+	if ( mode==BIBL_BIBTEXIN || mode==BIBL_BIBLATEXIN ) return 1;
+	else return 0;
+}
+
+static int
+stream_makescitekeys( stream *s )
+{
+	if ( !s->rp.output_raw ) return 1;
+	if ( s->rp.output_raw & BIBL_RAW_WITHMAKEREFID ) return 1;
+	return 0;
+}
+
+/* stream_charsetin()
+ *
+ * Take a character set found in the input, as read_refs() does, and
+ * rebuild the read-side converters only if it changes anything.
+ *
+ * Returns 1 if it did.
+ */
+static int
+stream_charsetin( stream *s, int fcharset )
+{
+	int charsetin = s->rp.charsetin, utf8in = s->rp.utf8in;
+
+	read_charset( &(s->rp), fcharset );
+	if ( s->rp.charsetin==CHARSET_UNICODE ) s->rp.utf8in = 1;
+
+	if ( s->rp.charsetin==charsetin && s->rp.utf8in==utf8in ) return 0;
+
+	bibl_fixcharsets_init( &(s->rtex), &(s->rnotex), &(s->rp) );
+	return 1;
+}
+
+/* stream_spool_put()
+ *
+ * Append a reference to the spool as its number of fields followed
+ * by the level, tag and value of each.
+ */
+static int
+stream_spool_putint( FILE *fp, long n )
+{
+	return ( fwrite( &n, sizeof( n ), 1, fp )==1 );
+}
+
+static int
+stream_spool_putstr( FILE *fp, const char *s )
+{
+	size_t n = strlen( s );
+
+	if ( !stream_spool_putint( fp, ( long ) n ) ) return 0;
+	if ( n && fwrite( s, 1, n, fp )!=n ) return 0;
+	return 1;
+}
+
+static int
+stream_spool_put( FILE *fp, fields *f )
+{
+	int i, n = fields_num( f );
+
+	if ( !stream_spool_putint( fp, n ) ) return BIBL_ERR_CANTOPEN;
+
+	for ( i=0; i<n; ++i ) {
+		if ( !stream_spool_putint( fp, fields_level( f, i ) ) ||
+		     !stream_spool_putstr( fp, fields_tag( f, i, FIELDS_CHRP_NOUSE ) ) ||
+		     !stream_spool_putstr( fp, fields_value( f, i, FIELDS_CHRP_NOUSE ) ) )
+			return BIBL_ERR_CANTOPEN;
+	}
+
+	return BIBL_OK;
+}
+
+/* stream_spool_get()
+ *
+ * Read the next reference from the spool into the empty f.
+ */
+static int
+stream_spool_getint( FILE *fp, long *n )
+{
+	return ( fread( n, sizeof( *n ), 1, fp )==1 );
+}
+
+static int
+stream_spool_getstr( FILE *fp, str *s )
+{
+	char buf[4096];
+	size_t m;
+	long n;
+
+	str_empty( s );
+	if ( !stream_spool_getint( fp, &n ) ) return 0;
+
+	while ( n > 0 ) {
+		m = ( n < ( long ) sizeof( buf ) ) ? ( size_t ) n : sizeof( buf );
+		if ( fread( buf, 1, m, fp )!=m ) return 0;
+		str_segcat( s, buf, buf + m );
+		n -= m;
+	}
+
+	return !str_memerr( s );
+}
+
+static int
+stream_spool_get( FILE *fp, fields *f, str *tag, str *value )
+{
+	long i, n, level;
+
+	if ( !stream_spool_getint( fp, &n ) ) return BIBL_ERR_CANTOPEN;
+
+	for ( i=0; i<n; ++i ) {
+		if ( !stream_spool_getint( fp, &level ) ||
+		     !stream_spool_getstr( fp, tag ) ||
+		     !stream_spool_getstr( fp, value ) )
+			return BIBL_ERR_CANTOPEN;
+		if ( fields_add_can_dup( f, str_cstr( tag ), str_cstr( value ), level )!=FIELDS_OK )
+			return BIBL_ERR_MEMERR;
+	}
+
+	return BIBL_OK;
+}
+
+/* stream_countcitekey()
+ *
+ * Give the reference a citekey the way get_citekeys() does, and count
+ * it.
+ */
+static int
+stream_countcitekey( stream *s, fields *f, long nref )
+{
+	str *citekey;
+	long nsame;
+	int n;
+
+	n = fields_find( f, "REFNUM", LEVEL_ANY );
+	if ( n==FIELDS_NOTFOUND ) n = generate_citekey( f, nref );
+	if ( n==FIELDS_NOTFOUND ) return BIBL_OK;
+
+	citekey = fields_value( f, n, FIELDS_STRP_NOUSE );
+
+	nsame = strhash_findn( &(s->citekeys), str_cstr( citekey ), citekey->len );
+	nsame = ( nsame==STRHASH_NOTFOUND ) ? 1 : nsame + 1;
+
+	if ( strhash_setn( &(s->citekeys), str_cstr( citekey ), citekey->len, nsame )!=STRHASH_OK )
+		return BIBL_ERR_MEMERR;
+
+	return BIBL_OK;
+}
+
+/* stream_citekey()
+ *
+ * Append "a", "b", ... to a citekey that occurs more than once, as
+ * resolve_duplicates() does.
+ */
+static int
+stream_citekey( stream *s, fields *f, long nref )
+{
+	int n, status = BIBL_OK;
+	str new_citekey, *citekey;
+	long nsame;
+
+	n = fields_find( f, "REFNUM", LEVEL_ANY );
+	if ( n==FIELDS_NOTFOUND ) n = generate_citekey( f, nref );
+	if ( n==FIELDS_NOTFOUND ) return BIBL_OK;
+
+	citekey = fields_value( f, n, FIELDS_STRP_NOUSE );
+
+	if ( strhash_findn( &(s->citekeys), str_cstr( citekey ), citekey->len ) < 2 )
+		return BIBL_OK;
+
+	nsame = strhash_findn( &(s->written), str_cstr( citekey ), citekey->len );
+	if ( nsame==STRHASH_NOTFOUND ) nsame = 0;
+
+	if ( strhash_setn( &(s->written), str_cstr( citekey ), citekey->len, nsame + 1 )!=STRHASH_OK )
+		return BIBL_ERR_MEMERR;
+
+	str_init( &new_citekey );
+
+	status = build_new_citekey( nsame, citekey, &new_citekey );
+	if ( status==BIBL_OK ) {
+		str_strcpy( citekey, &new_citekey );
+		if ( str_memerr( citekey ) ) status = BIBL_ERR_MEMERR;
+	}
+
+	str_free( &new_citekey );
+
+	return status;
+}
+
+static int
+stream_write( stream *s, fields *ref, long nref )
+{
+	int status;
+	FILE *fp;
+
+	if ( s->citekeys_made ) {
+		status = stream_citekey( s, ref, nref );
+		if ( status==BIBL_OK && s->rp.addcount )
+			status = bibl_addcountref( ref, nref );
+		if ( status!=BIBL_OK ) return status;
+	}
+
+	if ( debug_set( &(s->rp) ) ) bibl_verbose_reference( ref, s->filename, nref );
+
+	status = bibl_fixcharsetref( ref, &(s->wtex), &(s->wnotex) );
+	if ( status!=BIBL_OK ) return status;
+
+	if ( !s->wp.singlerefperfile )
+		return bibl_writeref( s->out, ref, &(s->assembled), &(s->wp), nref-1 );
+
+	fp = singlerefname( ref, nref-1, s->wp.writeformat );
+	if ( !fp ) return BIBL_ERR_CANTOPEN;
+
+	if ( s->wp.headerf ) s->wp.headerf( fp, &(s->wp) );
+	status = bibl_writeref( fp, ref, &(s->assembled), &(s->wp), nref-1 );
+	if ( s->wp.footerf ) s->wp.footerf( fp );
+	fclose( fp );
+
+	return status;
+}
+
+/* stream_ref()
+ *
+ * Take a raw reference that has been through processf (and cleanf)
+ * through the remaining read stages, and count its citekey, write it
+ * or, without a count yet, spool it.
+ */
+static int
+stream_ref( stream *s, fields *raw, long nref, int flags )
+{
+	fields *ref = raw, *conv = NULL;
+	int status = BIBL_OK;
+
+	if ( ( !s->rp.output_raw ) || ( s->rp.output_raw & BIBL_RAW_WITHCHARCONVERT ) ) {
+		status = bibl_fixcharsetref( raw, &(s->rtex), &(s->rnotex) );
+		if ( status!=BIBL_OK ) return status;
+	}
+
+	if ( !s->rp.output_raw ) {
+		conv = fields_new();
+		if ( !conv ) return BIBL_ERR_MEMERR;
+		status = convert_ref( raw, s->filename, nref, conv, &(s->rp) );
+		if ( status!=BIBL_OK ) goto out;
+		ref = conv;
+	}
+
+	if ( flags & STREAM_COUNT )
+		status = stream_countcitekey( s, ref, nref );
+
+	if ( status==BIBL_OK && ( flags & STREAM_WRITE ) ) {
+		if ( s->spool ) {
+			status = stream_countcitekey( s, ref, nref );
+			if ( status==BIBL_OK ) status = stream_spool_put( s->spool, ref );
+			if ( status==BIBL_OK ) s->nspool++;
+		}
+		else status = stream_write( s, ref, nref );
+	}
+out:
+	if ( conv ) fields_delete( conv );
+	return status;
+}
+
+/* stream_flush()
+ *
+ * Write the spooled references now that every citekey has been
+ * counted.
+ */
+static int
+stream_flush( stream *s )
+{
+	int status = BIBL_OK;
+	str tag, value;
+	long nref;
+	fields ref;
+
+	if ( fseek( s->spool, 0L, SEEK_SET ) ) return BIBL_ERR_CANTOPEN;
+
+	strs_init( &tag, &value, NULL );
+	fields_init( &ref );
+
+	for ( nref=1; nref<=s->nspool; ++nref ) {
+
+		status = stream_spool_get( s->spool, &ref, &tag, &value );
+		if ( status==BIBL_OK )
+			status = stream_write( s, &ref, nref );
+		if ( status!=BIBL_OK ) break;
+
+		fields_free( &ref );
+	}
+
+	fields_free( &ref );
+	strs_free( &tag, &value, NULL );
+
+	return status;
+}
+
+/* stream_all()
+ *
+ * Read, clean and convert the references of formats that need the
+ * complete input before cleanf can run, when it can't be read again.
+ */
+static int
+stream_all( stream *s, bibl_input *in )
+{
+	int status;
+	bibl bin;
+	long i;
+
+	bibl_init( &bin );
+
+	status = read_refs( in, &bin, s->filename, &(s->rp) );
+	if ( status!=BIBL_OK ) goto out;
+
+	status = clean_refs( &bin, &(s->rp) );
+	if ( status!=BIBL_OK ) goto out;
+
+	bibl_fixcharsets_init( &(s->rtex), &(s->rnotex), &(s->rp) );
+
+	for ( i=0; i<bin.n; ++i ) {
+		status = stream_ref( s, bin.ref[i], i+1, STREAM_WRITE );
+		if ( status!=BIBL_OK ) goto out;
+		fields_delete( bin.ref[i] );
+		bin.ref[i] = NULL;
+	}
+out:
+	bibl_free( &bin );
+	return status;
+}
+
+/* stream_key()
+ *
+ * Clean a citekey or crossref value of the input as cleanf would, so
+ * that the keys match the way bibl_findref() will match them. The
+ * readers clean both tags alike.
+ */
+static int
+stream_key( stream *s, fields *raw, const char *tag, str *key )
+{
+	fields *f;
+	bibl one;
+	int n, status;
+
+	str_empty( key );
+
+	n = fields_find( raw, tag, LEVEL_ANY );
+	if ( n==FIELDS_NOTFOUND ) return BIBL_OK;
+
+	bibl_init( &one );
+
+	f = fields_new();
+	if ( !f ) return BIBL_ERR_MEMERR;
+
+	if ( fields_add( f, "REFNUM", fields_value( raw, n, FIELDS_CHRP_NOUSE ), LEVEL_MAIN )!=FIELDS_OK ) {
+		fields_delete( f );
+		return BIBL_ERR_MEMERR;
+	}
+
+	status = bibl_addref( &one, f );
+	if ( status!=BIBL_OK ) {
+		fields_delete( f );
+		return status;
+	}
+
+	status = clean_refs( &one, &(s->rp) );
+
+	if ( status==BIBL_OK ) {
+		n = fields_find( f, "REFNUM", LEVEL_ANY );
+		if ( n!=FIELDS_NOTFOUND ) str_strcpy( key, fields_value( f, n, FIELDS_STRP_NOUSE ) );
+		if ( str_memerr( key ) ) status = BIBL_ERR_MEMERR;
+	}
+
+	bibl_free( &one );
+
+	return status;
+}
+
+/* stream_keep()
+ *
+ * Keep a copy of the first reference with a citekey that a crossref
+ * points to.
+ */
+static int
+stream_keep( stream *s, fields *raw, long nref )
+{
+	fields *copy;
+	int status;
+	str key;
+
+	str_init( &key );
+
+	status = stream_key( s, raw, "REFNUM", &key );
+	if ( status!=BIBL_OK || key.len==0 ) goto out;
+
+	if ( strhash_findn( &(s->crossrefs), str_cstr( &key ), key.len )==STRHASH_NOTFOUND ) goto out;
+	if ( strhash_findn( &(s->targetkeys), str_cstr( &key ), key.len )!=STRHASH_NOTFOUND ) goto out;
+
+	/* targetpos holds ints */
+	if ( nref > INT_MAX ) { status = BIBL_ERR_MEMERR; goto out; }
+
+	copy = fields_dupl( raw );
+	if ( !copy ) { status = BIBL_ERR_MEMERR; goto out; }
+
+	status = bibl_addref( &(s->targets), copy );
+	if ( status!=BIBL_OK ) { fields_delete( copy ); goto out; }
+
+	if ( intlist_add( &(s->targetpos), ( int ) nref )!=INTLIST_OK ||
+	     strhash_addn( &(s->targetkeys), str_cstr( &key ), key.len, s->targets.n-1 )!=STRHASH_OK )
+		status = BIBL_ERR_MEMERR;
+out:
+	str_free( &key );
+	return status;
+}
+
+/* stream_clean()
+ *
+ * Clean a reference with a crossref. cleanf sees the reference among
+ * (copies of) the references its crossref leads to, in input order,
+ * so that it merges the same fields as with the complete input.
+ *
+ * An unresolved crossref at the end of the chain gets a stand-in with
+ * just that citekey, so that the reader warns about it only for the
+ * reference itself, and only when writing it.
+ */
+static int
+stream_clean( stream *s, fields *ref, long nref, int quiet )
+{
+	int i, j, n, k = -1, status = BIBL_OK;
+	fields *f, *last = ref, *dummy = NULL;
+	intlist chain;
+	bibl sub;
+	long t;
+	str key;
+
+	intlist_init( &chain );
+	bibl_init( &sub );
+	str_init( &key );
+
+	while ( 1 ) {
+		status = stream_key( s, last, "CROSSREF", &key );
+		if ( status!=BIBL_OK ) goto out;
+		if ( key.len==0 ) break;
+
+		t = strhash_findn( &(s->targetkeys), str_cstr( &key ), key.len );
+		if ( t==STRHASH_NOTFOUND ) {
+			if ( last==ref && !quiet ) break;
+			n = fields_find( last, "CROSSREF", LEVEL_ANY );
+			dummy = fields_new();
+			if ( !dummy ) { status = BIBL_ERR_MEMERR; goto out; }
+			if ( fields_add( dummy, "REFNUM", fields_value( last, n, FIELDS_CHRP_NOUSE ), LEVEL_MAIN )!=FIELDS_OK )
+				status = BIBL_ERR_MEMERR;
+			break;
+		}
+
+		if ( intlist_get( &(s->targetpos), t )==nref ) break;
+		if ( intlist_find( &chain, t )!=-1 ) break;
+		if ( intlist_add( &chain, t )!=INTLIST_OK ) { status = BIBL_ERR_MEMERR; goto out; }
+
+		last = s->targets.ref[t];
+	}
+	if ( status!=BIBL_OK ) goto out;
+
+	/* the chain is short, sort it by reference number in place */
+	for ( i=1; i<chain.n; ++i ) {
+		t = intlist_get( &chain, i );
+		for ( j=i; j>0 && intlist_get( &(s->targetpos), intlist_get( &chain, j-1 ) ) > intlist_get( &(s->targetpos), t ); --j )
+			intlist_set( &chain, j, intlist_get( &chain, j-1 ) );
+		intlist_set( &chain, j, t );
+	}
+
+	for ( i=0; i<=chain.n; ++i ) {
+
+		if ( k==-1 && ( i==chain.n || intlist_get( &(s->targetpos), intlist_get( &chain, i ) ) > nref ) ) {
+			status = bibl_addref( &sub, ref );
+			if ( status!=BIBL_OK ) goto out;
+			k = sub.n - 1;
+		}
+		if ( i==chain.n ) break;
+
+		f = fields_dupl( s->targets.ref[ intlist_get( &chain, i ) ] );
+		if ( !f ) { status = BIBL_ERR_MEMERR; goto out; }
+		status = bibl_addref( &sub, f );
+		if ( status!=BIBL_OK ) { fields_delete( f ); goto out; }
+	}
+
+	if ( dummy ) {
+		status = bibl_addref( &sub, dummy );
+		if ( status!=BIBL_OK ) goto out;
+		dummy = NULL;
+	}
+
+	status = clean_refs( &sub, &(s->rp) );
+out:
+	if ( k!=-1 ) sub.ref[k] = NULL; /* ref belongs to the caller */
+	if ( dummy ) fields_delete( dummy );
+	bibl_free( &sub );
+	intlist_free( &chain );
+	str_free( &key );
+	return status;
+}
+
+/* stream_oneref()
+ *
+ * Do what the pass is for with a reference that processf has just
+ * made.
+ */
+static int
+stream_oneref( stream *s, fields *ref, long nref, int flags )
+{
+	int n, status = BIBL_OK;
+	bibl one;
+	str key;
+
+	n = ( s->needsall ) ? fields_find( ref, "CROSSREF", LEVEL_ANY ) : FIELDS_NOTFOUND;
+
+	if ( n!=FIELDS_NOTFOUND && ( flags & STREAM_KEYS ) ) {
+		str_init( &key );
+		status = stream_key( s, ref, "CROSSREF", &key );
+		if ( status==BIBL_OK && key.len &&
+		     strhash_setn( &(s->crossrefs), str_cstr( &key ), key.len, 1 )!=STRHASH_OK )
+			status = BIBL_ERR_MEMERR;
+		str_free( &key );
+		if ( status!=BIBL_OK ) return status;
+	}
+
+	if ( flags & STREAM_TARGETS ) {
+		status = stream_keep( s, ref, nref );
+		if ( status!=BIBL_OK ) return status;
+	}
+
+	if ( !( flags & ( STREAM_COUNT | STREAM_WRITE ) ) ) return BIBL_OK;
+	if ( n!=FIELDS_NOTFOUND && !( flags & STREAM_LINKED ) ) return BIBL_OK;
+	if ( n==FIELDS_NOTFOUND && !( flags & STREAM_UNLINKED ) ) return BIBL_OK;
+
+	if ( !s->rp.output_raw ) {
+		if ( n!=FIELDS_NOTFOUND )
+			status = stream_clean( s, ref, nref, !( flags & STREAM_WRITE ) );
+		else {
+			bibl_init( &one );
+			status = bibl_addref( &one, ref );
+			if ( status==BIBL_OK ) status = clean_refs( &one, &(s->rp) );
+			if ( one.n ) one.ref[0] = NULL;
+			bibl_free( &one );
+		}
+		if ( status!=BIBL_OK ) return status;
+	}
+
+	return stream_ref( s, ref, nref, flags );
+}
+
+/* stream_pass()
+ *
+ * Read the input once, starting over with the @STRING macros. The
+ * character set is settled on the first pass; later passes use what
+ * it ended with, as bibl_read() converts all references with the
+ * character set found last.
+ */
+static int
+stream_pass( stream *s, bibl_input *in, int flags )
+{
+	int fcharset, status = BIBL_OK;
+	str reference, line;
+	long nref = 0;
+	fields *ref;
+
+	if ( s->npass++ ) {
+		status = bibl_input_rewind( in );
+		if ( status!=BIBL_OK ) return status;
+		strhash_free( &(s->rp.stringnames) );
+		strhash_init( &(s->rp.stringnames), STRHASH_CASE );
+		slist_free( &(s->rp.stringvalues) );
+	}
+
+	strs_init( &reference, &line, NULL );
+
+	while ( bibl_input_next( in, &(s->rp), &line, &reference, &fcharset ) ) {
+
+		if ( s->npass==1 && stream_charsetin( s, fcharset ) && nref && ( flags & STREAM_COUNT ) )
+			s->recount = 1;
+
+		if ( reference.len==0 ) continue;
+
+		ref = fields_new();
+		if ( !ref ) {
+			status = BIBL_ERR_MEMERR;
+			goto out;
+		}
+
+		if ( s->rp.processf( ref, reference.data, s->filename, nref+1, &(s->rp) ) ) {
+			nref += 1;
+			status = stream_oneref( s, ref, nref, flags );
+		}
+
+		fields_delete( ref );
+		if ( status!=BIBL_OK ) goto out;
+
+		str_empty( &reference );
+	}
+	if ( in->in.status!=INBUF_OK ) status = BIBL_ERR_MEMERR;
+out:
+	strs_free( &reference, &line, NULL );
+	return status;
+}
+
+/* stream_passes()
+ *
+ * Go over seekable input as many times as needed; see above. Input
+ * that can't be seeked is read once, with stream_all() for formats
+ * whose cleanf needs the complete input.
+ */
+static int
+stream_passes( stream *s, bibl_input *in )
+{
+	int status, flags = STREAM_LINKED | STREAM_UNLINKED;
+
+	if ( !bibl_input_seekable( in ) ) {
+		if ( s->citekeys_made ) {
+			s->spool = tmpfile();
+			if ( !s->spool ) return BIBL_ERR_CANTOPEN;
+		}
+		if ( s->needsall ) status = stream_all( s, in );
+		else status = stream_pass( s, in, STREAM_WRITE | flags );
+		if ( status==BIBL_OK && s->spool ) status = stream_flush( s );
+		return status;
+	}
+
+	if ( !s->needsall && !s->citekeys_made )
+		return stream_pass( s, in, STREAM_WRITE | flags );
+
+	/* references without a crossref don't need the others, so count them now */
+	if ( s->needsall )
+		status = stream_pass( s, in, STREAM_KEYS | ( s->citekeys_made ? STREAM_COUNT | STREAM_UNLINKED : 0 ) );
+	else
+		status = stream_pass( s, in, STREAM_COUNT | flags );
+	if ( status!=BIBL_OK ) return status;
+
+	if ( s->recount ) {
+		strhash_empty( &(s->citekeys) );
+		flags = STREAM_LINKED | STREAM_UNLINKED;
+	}
+	else flags = STREAM_LINKED;
+
+	if ( s->crossrefs.n ) {
+		status = stream_pass( s, in, STREAM_TARGETS );
+		if ( status!=BIBL_OK ) return status;
+	}
+	else if ( !s->recount ) flags = 0; /* nothing links */
+
+	if ( s->citekeys_made && flags ) {
+		status = stream_pass( s, in, STREAM_COUNT | flags );
+		if ( status!=BIBL_OK ) return status;
+	}
+
+	return stream_pass( s, in, STREAM_WRITE | STREAM_LINKED | STREAM_UNLINKED );
+}
+
+int
+bibl_convert_stream( FILE *in, char *filename, FILE *out, param *rp, param *wp )
+{
+	bibl_input input;
+	int status;
+	stream s;
+
+	if ( !in ) return BIBL_ERR_BADINPUT;
+	if ( !rp ) return BIBL_ERR_BADINPUT;
+	if ( !wp ) return BIBL_ERR_BADINPUT;
+	if ( bibl_illegalinmode( rp->readformat ) ) return BIBL_ERR_BADINPUT;
+	if ( bibl_illegaloutmode( wp->writeformat ) ) return BIBL_ERR_BADINPUT;
+	if ( !out && !wp->singlerefperfile ) return BIBL_ERR_BADINPUT;
+
+	status = bibl_setreadparams( &(s.rp), rp );
+	if ( status!=BIBL_OK ) return status;
+
+	status = bibl_setwriteparams( &(s.wp), wp );
+	if ( status!=BIBL_OK ) {
+		bibl_freeparams( &(s.rp) );
+		return status;
+	}
+
+	status = bibl_input_initfp( &input, in, &(s.rp) );
+	if ( status!=BIBL_OK ) {
+		bibl_input_free( &input );
+		bibl_freeparams( &(s.wp) );
+		bibl_freeparams( &(s.rp) );
+		return status;
+	}
+
+	if ( debug_set( &(s.rp) ) ) report_params( stderr, "bibl_convert_stream", &(s.rp) );
+	if ( debug_set( &(s.wp) ) ) report_params( stderr, "bibl_convert_stream", &(s.wp) );
+
+	s.filename      = filename;
+	s.out           = out;
+	s.citekeys_made = stream_makescitekeys( &s );
+	s.needsall      = ( !s.rp.output_raw && bibl_readformat_needsall( s.rp.readformat ) );
+	s.npass         = 0;
+	s.recount       = 0;
+	s.spool         = NULL;
+	s.nspool        = 0;
+	strhash_init( &(s.citekeys), STRHASH_CASE );
+	strhash_init( &(s.written), STRHASH_CASE );
+	strhash_init( &(s.crossrefs), STRHASH_CASE );
+	strhash_init( &(s.targetkeys), STRHASH_CASE );
+	bibl_init( &(s.targets) );
+	intlist_init( &(s.targetpos) );
+	bibl_fixcharsets_init( &(s.rtex), &(s.rnotex), &(s.rp) );
+	bibl_fixcharsets_init( &(s.wtex), &(s.wnotex), &(s.wp) );
+	fields_init( &(s.assembled) );
+
+	if ( !s.wp.singlerefperfile && s.wp.headerf ) s.wp.headerf( out, &(s.wp) );
+
+	status = stream_passes( &s, &input );
+
+	if ( !s.wp.singlerefperfile && s.wp.footerf ) s.wp.footerf( out );
+
+	fields_free( &(s.assembled) );
+	intlist_free( &(s.targetpos) );
+	bibl_free( &(s.targets) );
+	strhash_free( &(s.targetkeys) );
+	strhash_free( &(s.crossrefs) );
+	strhash_free( &(s.written) );
+	strhash_free( &(s.citekeys) );
+	if ( s.spool ) fclose( s.spool );
+	bibl_input_free( &input );
+	bibl_freeparams( &(s.wp) );
+	bibl_freeparams( &(s.rp) );
+
+	return status;
+}
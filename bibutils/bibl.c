@@ -15,8 +15,40 @@
 void
 bibl_init( bibl *b )
 {
-	b->n   = b->max = 0L;
-	b->ref = NULL;
+	b->n     = b->max = 0L;
+	b->ref   = NULL;
+	b->index = NULL;
+	b->mem   = NULL;
+}
+
+/* bibl_initarena()
+ *
+ * Initialize a bibl whose references (made with bibl_newref()) are
+ * allocated from an arena, so that bibl_free() can release them all
+ * at once, without visiting each of them. References made in the
+ * arena must not outlive the bibl, and only references from
+ * bibl_newref() may be added to it.
+ *
+ * returns BIBL_OK on success, BIBL_ERR_MEMERR on failure
+ */
+int
+bibl_initarena( bibl *b )
+{
+	bibl_init( b );
+	b->mem = arena_new();
+	if ( !b->mem ) return BIBL_ERR_MEMERR;
+	return BIBL_OK;
+}
+
+/* bibl_newref()
+ *
+ * returns an empty reference to be added to b, or NULL on memory error
+ */
+fields *
+bibl_newref( bibl *b )
+{
+	if ( b->mem ) return fields_newarena( b->mem );
+	else return fields_new();
 }
 
 static int
@@ -47,6 +79,80 @@ bibl_realloc( bibl * b )
 	return BIBL_OK;
 }
 
+static const char *
+bibl_citekey( fields *ref )
+{
+	int n;
+
+	n = fields_find( ref, "refnum", LEVEL_ANY );
+	if ( n==FIELDS_NOTFOUND ) return NULL;
+
+	return fields_value( ref, n, FIELDS_CHRP_NOUSE );
+}
+
+/* bibl_indexref()
+ *
+ * Add reference n to the citekey index; earlier references with
+ * the same citekey take priority.
+ */
+static int
+bibl_indexref( bibl *b, long n )
+{
+	const char *citekey;
+	int status;
+
+	if ( !b->ref[n] ) return BIBL_OK;
+
+	citekey = bibl_citekey( b->ref[n] );
+	if ( !citekey ) return BIBL_OK;
+
+	status = strhash_add( b->index, citekey, n );
+
+	return ( status==STRHASH_OK ) ? BIBL_OK : BIBL_ERR_MEMERR;
+}
+
+/* bibl_buildindex()
+ *
+ * returns BIBL_OK on success, BIBL_ERR_MEMERR on failure (with no index)
+ */
+static int
+bibl_buildindex( bibl *b )
+{
+	int status;
+	long i;
+
+	b->index = ( strhash * ) malloc( sizeof( strhash ) );
+	if ( !b->index ) return BIBL_ERR_MEMERR;
+
+	strhash_init( b->index, STRHASH_CASE );
+
+	for ( i=0; i<b->n; ++i ) {
+		status = bibl_indexref( b, i );
+		if ( status!=BIBL_OK ) {
+			bibl_clearindex( b );
+			return status;
+		}
+	}
+
+	return BIBL_OK;
+}
+
+/* bibl_clearindex()
+ *
+ * Drop the citekey index; it is rebuilt by the next bibl_findref().
+ * Must be called after changing the citekey of a reference that is
+ * already in the bibl.
+ */
+void
+bibl_clearindex( bibl *b )
+{
+	if ( !b->index ) return;
+
+	strhash_free( b->index );
+	free( b->index );
+	b->index = NULL;
+}
+
 int
 bibl_addref( bibl *b, fields *ref )
 {
@@ -60,6 +166,8 @@ bibl_addref( bibl *b, fields *ref )
 	if ( status==BIBL_OK ) {
 		b->ref[ b->n ] = ref;
 		b->n++;
+		if ( b->index && bibl_indexref( b, b->n-1 )!=BIBL_OK )
+			bibl_clearindex( b );
 	}
 	return status;
 }
@@ -69,11 +177,16 @@ bibl_free( bibl *b )
 {
 	long i;
 
-	for ( i=0; i<b->n; ++i )
-		fields_delete( b->ref[i] );
+	/* references in the arena go with it, see bibl_initarena() */
+	if ( !b->mem ) {
+		for ( i=0; i<b->n; ++i )
+			if ( b->ref[i] ) fields_delete( b->ref[i] );
+	}
 
 	free( b->ref );
 
+	bibl_clearindex( b );
+	arena_delete( b->mem );
 	bibl_init( b );
 }
 
@@ -90,11 +203,20 @@ bibl_copy( bibl *bout, bibl *bin )
 
 	for ( i=0; i<bin->n; ++i ) {
 
-		ref = fields_dupl( bin->ref[i] );
+		/* bibl_newref() so that an arena-backed bout owns the copy */
+		ref = bibl_newref( bout );
 		if ( !ref ) return BIBL_ERR_MEMERR;
 
+		if ( fields_copy( ref, bin->ref[i] )!=FIELDS_OK ) {
+			fields_delete( ref );
+			return BIBL_ERR_MEMERR;
+		}
+
 		status = bibl_addref( bout, ref );
-		if ( status!=BIBL_OK ) return status;
+		if ( status!=BIBL_OK ) {
+			fields_delete( ref );
+			return status;
+		}
 
 	}
 
@@ -104,19 +226,28 @@ bibl_copy( bibl *bout, bibl *bin )
 /* bibl_findref()
  *
  * returns position of reference matching citekey, else -1
+ *
+ * The first lookup builds a citekey index that bibl_addref() keeps up
+ * to date; if it cannot be built, fall back to a linear search.
  */
 long
 bibl_findref( bibl *bin, const char *citekey )
 {
+	const char *refkey;
 	long i;
-	int n;
+
+	if ( !bin->index ) bibl_buildindex( bin );
+
+	if ( bin->index ) return strhash_find( bin->index, citekey );
 
 	for ( i=0; i<bin->n; ++i ) {
 
-		n = fields_find( bin->ref[i], "refnum", LEVEL_ANY );
-		if ( n==FIELDS_NOTFOUND ) continue;
+		if ( !bin->ref[i] ) continue;
+
+		refkey = bibl_citekey( bin->ref[i] );
+		if ( !refkey ) continue;
 
-		if ( !strcmp( fields_value( bin->ref[i], n, FIELDS_CHRP_NOUSE ), citekey ) ) return i;
+		if ( !strcmp( refkey, citekey ) ) return i;
 
 	}
 
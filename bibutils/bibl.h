@@ -13,18 +13,24 @@
 #include "str.h"
 #include "fields.h"
 #include "reftypes.h"
+#include "strhash.h"
 
 typedef struct {
 	long n;
 	long max;
 	fields **ref;
+	strhash *index; /* citekey->position, built by first bibl_findref() */
+	arena *mem;     /* if set, bibl_newref() allocates references here */
 } bibl;
 
 void bibl_init( bibl *b );
+int  bibl_initarena( bibl *b );
+fields *bibl_newref( bibl *b );
 int  bibl_addref( bibl *b, fields *ref );
 void bibl_free( bibl *b );
 int  bibl_copy( bibl *bout, bibl *bin );
 long bibl_findref( bibl *bin, const char *citekey );
+void bibl_clearindex( bibl *b );
 
 #endif
 
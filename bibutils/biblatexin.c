@@ -27,9 +27,6 @@
 extern variants biblatex_all[];
 extern int biblatex_nall;
 
-static slist find    = { 0, 0, 0, NULL };
-static slist replace = { 0, 0, 0, NULL };
-
 /*****************************************************
  PUBLIC: void biblatexin_initparams()
 *****************************************************/
@@ -37,7 +34,7 @@ static slist replace = { 0, 0, 0, NULL };
 static int  biblatexin_convertf( fields *bibin, fields *info, int reftype, param *p );
 static int  biblatexin_processf( fields *bibin, const char *data, const char *filename, long nref, param *p );
 static int  biblatexin_cleanf( bibl *bin, param *p );
-static int  biblatexin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int  biblatexin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int  biblatexin_typef( fields *bibin, const char *filename, int nrefs, param *p );
 
 int
@@ -54,7 +51,8 @@ biblatexin_initparams( param *pm, const char *progname )
 	pm->addcount         = 0;
 	pm->output_raw       = 0;
 
-	pm->readf    = biblatexin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = biblatexin_readf;
 	pm->processf = biblatexin_processf;
 	pm->cleanf   = biblatexin_cleanf;
 	pm->typef    = biblatexin_typef;
@@ -81,16 +79,16 @@ biblatexin_initparams( param *pm, const char *progname )
 /*
  * readf can "read too far", so we store this information in line, thus
  * the next new text is in line, either from having read too far or
- * from the next chunk obtained via str_fget()
+ * from the next chunk obtained via inbuf_getstr()
  *
  * return 1 on success, 0 on error/end-of-file
  *
  */
 static int
-readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
+readmore( inbuf *in, str *line )
 {
 	if ( line->len ) return 1;
-	else return str_fget( fp, buf, bufsize, bufpos, line );
+	else return inbuf_getstr( in, line );
 }
 
 /*
@@ -100,11 +98,11 @@ readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
  * returns 1 if last reference in file, 2 if reference within file
  */
 static int
-biblatexin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+biblatexin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	int haveref = 0;
 	const char *p;
-	while ( haveref!=2 && readmore( fp, buf, bufsize, bufpos, line ) ) {
+	while ( haveref!=2 && readmore( in, line ) ) {
 		if ( line->len == 0 ) continue; /* blank line */
 		p = &(line->data[0]);
 		p = skip_ws( p );
@@ -266,17 +264,18 @@ outerr:
 static void
 replace_strings( slist *tokens, fields *bibin, long nref, param *pm )
 {
-	int i, n, ok;
+	int i, ok;
 	char *q;
+	long n;
 	str *s;
 	i = 0;
 	while ( i < tokens->n ) {
 		s = slist_str( tokens, i );
 		if ( !strcmp( s->data, "#" ) ) {
 		} else if ( s->data[0]!='\"' && s->data[0]!='{' ) {
-			n = slist_find( &find, s );
-			if ( n!=-1 ) {
-				str_strcpy( s, slist_str( &replace, n ) );
+			n = strhash_findn( &(pm->stringnames), s->data, s->len );
+			if ( n!=STRHASH_NOTFOUND ) {
+				str_strcpy( s, slist_str( &(pm->stringvalues), n ) );
 			} else {
 				q = s->data;
 				ok = 1;
@@ -426,8 +425,11 @@ out:
 static int
 process_string( const char *p, long nref, param *pm )
 {
-	int n, status = BIBL_OK;
+	slist *values = &(pm->stringvalues);
+	strhash *names = &(pm->stringnames);
+	int status = BIBL_OK;
 	str s1, s2, *s;
+	long n;
 	strs_init( &s1, &s2, NULL );
 	while ( *p && *p!='{' && *p!='(' ) p++;
 	if ( *p=='{' || *p=='(' ) p++;
@@ -439,15 +441,17 @@ process_string( const char *p, long nref, param *pm )
 		str_strcpyc( &s2, "" );
 	}
 	if ( str_has_value( &s1 ) ) {
-		n = slist_find( &find, &s1 );
-		if ( n==-1 ) {
-			status = slist_add_ret( &find, &s1, BIBL_OK, BIBL_ERR_MEMERR );
-			if ( status!=BIBL_OK ) goto out;
-			status = slist_add_ret( &replace, &s2, BIBL_OK, BIBL_ERR_MEMERR );
+		n = strhash_findn( names, s1.data, s1.len );
+		if ( n==STRHASH_NOTFOUND ) {
+			status = slist_add_ret( values, &s2, BIBL_OK, BIBL_ERR_MEMERR );
 			if ( status!=BIBL_OK ) goto out;
+			if ( strhash_addn( names, s1.data, s1.len, values->n-1 )!=STRHASH_OK ) {
+				status = BIBL_ERR_MEMERR;
+				goto out;
+			}
 		} else {
-			if ( str_has_value( &s2 ) ) s = slist_set( &replace, n, &s2 );
-			else s = slist_setc( &replace, n, "" );
+			if ( str_has_value( &s2 ) ) s = slist_set( values, n, &s2 );
+			else s = slist_setc( values, n, "" );
 			if ( s==NULL ) { status = BIBL_ERR_MEMERR; goto out; }
 		}
 	}
@@ -473,41 +477,41 @@ biblatexin_processf( fields *bibin, const char *data, const char *filename, long
 *****************************************************/
 
 static int
-is_url_tag( str *tag )
+is_url_tag( const char *tag )
 {
-	if ( str_has_value( tag ) ) {
-		if ( !strcasecmp( str_cstr( tag ), "url" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "file" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "doi" ) ) return 1;
+	if ( tag[0] ) {
+		if ( !strcasecmp( tag, "url" ) ) return 1;
+		if ( !strcasecmp( tag, "file" ) ) return 1;
+		if ( !strcasecmp( tag, "doi" ) ) return 1;
 	}
 	return 0;
 }
 
 static int
-is_name_tag( str *tag )
+is_name_tag( const char *tag )
 {
-	if ( str_has_value( tag ) ) {
-		if ( !strcasecmp( str_cstr( tag ), "author" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "editor" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "editorb" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "editorc" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "director" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "producer" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "execproducer" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "writer" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "redactor" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "annotator" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "commentator" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "translator" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "foreword" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "afterword" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "introduction" ) ) return 1;
+	if ( tag[0] ) {
+		if ( !strcasecmp( tag, "author" ) ) return 1;
+		if ( !strcasecmp( tag, "editor" ) ) return 1;
+		if ( !strcasecmp( tag, "editorb" ) ) return 1;
+		if ( !strcasecmp( tag, "editorc" ) ) return 1;
+		if ( !strcasecmp( tag, "director" ) ) return 1;
+		if ( !strcasecmp( tag, "producer" ) ) return 1;
+		if ( !strcasecmp( tag, "execproducer" ) ) return 1;
+		if ( !strcasecmp( tag, "writer" ) ) return 1;
+		if ( !strcasecmp( tag, "redactor" ) ) return 1;
+		if ( !strcasecmp( tag, "annotator" ) ) return 1;
+		if ( !strcasecmp( tag, "commentator" ) ) return 1;
+		if ( !strcasecmp( tag, "translator" ) ) return 1;
+		if ( !strcasecmp( tag, "foreword" ) ) return 1;
+		if ( !strcasecmp( tag, "afterword" ) ) return 1;
+		if ( !strcasecmp( tag, "introduction" ) ) return 1;
 	}
 	return 0;
 }
 
 static int
-biblatexin_cleanvalue( str *tag, str *value, fields *bibin, param *p )
+biblatexin_cleanvalue( const char *tag, str *value, fields *bibin, param *p )
 {
 	int status = BIBL_OK;
 	str parsed;
@@ -595,20 +599,21 @@ static int
 biblatexin_cleanref( fields *bibin, param *p )
 {
 	int i, n, status;
-	str *t, *d;
+	const char *t;
+	str *d;
 	n = fields_num( bibin );
 	for ( i=0; i<n; ++i ) {
-		t = fields_tag( bibin, i, FIELDS_STRP_NOUSE );
+		t = fields_tag( bibin, i, FIELDS_CHRP_NOUSE );
 		d = fields_value( bibin, i, FIELDS_STRP_NOUSE );
 		status = biblatexin_cleanvalue( t, d, bibin, p );
 		if ( status!=BIBL_OK ) return status;
-		if ( !strsearch( str_cstr( t ), "AUTHORS" ) ) {
+		if ( !strsearch( t, "AUTHORS" ) ) {
 			str_findreplace( d, "\n", " " );
 			str_findreplace( d, "\r", " " );
 		}
-		else if ( !strsearch( str_cstr( t ), "ABSTRACT" ) ||
-		     !strsearch( str_cstr( t ), "SUMMARY" ) || 
-		     !strsearch( str_cstr( t ), "NOTE" ) ) {
+		else if ( !strsearch( t, "ABSTRACT" ) ||
+		     !strsearch( t, "SUMMARY" ) || 
+		     !strsearch( t, "NOTE" ) ) {
 			str_findreplace( d, "\n", "" );
 			str_findreplace( d, "\r", "" );
 		}
@@ -666,7 +671,8 @@ static int
 get_title_elements( fields *bibin, int currlevel, int reftype, variants *all, int nall, str *ttl, str *subttl, str *ttladdon )
 {
 	int nfields, process, level, i;
-	str *t, *d;
+	const char *t;
+	str *d;
 	char *newtag;
 
 	strs_empty( ttl, subttl, ttladdon, NULL );
@@ -679,11 +685,11 @@ get_title_elements( fields *bibin, int currlevel, int reftype, variants *all, in
 		if ( fields_used( bibin, i ) ) continue;
 
 		/* ...skip empty elements */
-		t = fields_tag  ( bibin, i, FIELDS_STRP_NOUSE );
+		t = fields_tag  ( bibin, i, FIELDS_CHRP_NOUSE );
 		d = fields_value( bibin, i, FIELDS_STRP_NOUSE );
 		if ( d->len == 0 ) continue;
 
-		if ( !translate_oldtag( t->data, reftype, all, nall, &process, &level, &newtag ) )
+		if ( !translate_oldtag( t, reftype, all, nall, &process, &level, &newtag ) )
 			continue;
 		if ( process != TITLE ) continue;
 		if ( level != currlevel ) continue;
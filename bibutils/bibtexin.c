@@ -25,9 +25,6 @@
 #include "bibformats.h"
 #include "generic.h"
 
-static slist find    = { 0, 0, 0, NULL };
-static slist replace = { 0, 0, 0, NULL };
-
 extern variants bibtex_all[];
 extern int bibtex_nall;
 
@@ -38,7 +35,7 @@ extern int bibtex_nall;
 static int bibtexin_convertf( fields *bibin, fields *info, int reftype, param *p );
 static int bibtexin_processf( fields *bibin, const char *data, const char *filename, long nref, param *p );
 static int bibtexin_cleanf( bibl *bin, param *p );
-static int bibtexin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int bibtexin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int bibtexin_typef( fields *bibin, const char *filename, int nrefs, param *p );
 
 int
@@ -55,7 +52,8 @@ bibtexin_initparams( param *pm, const char *progname )
 	pm->addcount         = 0;
 	pm->output_raw       = 0;
 
-	pm->readf    = bibtexin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = bibtexin_readf;
 	pm->processf = bibtexin_processf;
 	pm->cleanf   = bibtexin_cleanf;
 	pm->typef    = bibtexin_typef;
@@ -80,54 +78,55 @@ bibtexin_initparams( param *pm, const char *progname )
 *****************************************************/
 
 /*
+ * readf()
+ *
  * readf can "read too far", so we store this information in line, thus
  * the next new text is in line, either from having read too far or
- * from the next chunk obtained via str_fget()
- *
- * return 1 on success, 0 on error/end-of-file
- *
- */
-static int
-readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
-{
-	if ( line->len ) return 1;
-	else return str_fget( fp, buf, bufsize, bufpos, line );
-}
-
-/*
- * readf()
+ * from the next line obtained via inbuf_getline(). Other lines are
+ * looked at where inbuf_getline() leaves them, so only the line read
+ * too far is copied.
  *
  * returns zero if cannot get reference and hit end of-file
  * returns 1 if last reference in file, 2 if reference within file
  */
 static int
-bibtexin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+bibtexin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	int haveref = 0;
-	const char *p;
+	const char *start, *p, *end;
+	size_t len;
 	*fcharset = CHARSET_UNKNOWN;
-	while ( haveref!=2 && readmore( fp, buf, bufsize, bufpos, line ) ) {
-		if ( line->len == 0 ) continue; /* blank line */
-		p = &(line->data[0]);
+	while ( haveref!=2 ) {
+		if ( line->len ) {
+			start = str_cstr( line );
+			len   = line->len;
+		}
+		else if ( !inbuf_getline( in, &start, &len ) ) break;
+		if ( len == 0 ) continue; /* blank line */
+		p = start;
+		/* the line isn't '\0'-terminated; stop where a copy would */
+		end = memchr( p, '\0', len );
+		if ( !end ) end = p + len;
 		/* Recognize UTF8 BOM */
-		if ( line->len > 2 && 
+		if ( end - p > 2 &&
 				(unsigned char)(p[0])==0xEF &&
 				(unsigned char)(p[1])==0xBB &&
 				(unsigned char)(p[2])==0xBF ) {
 			*fcharset = CHARSET_UNICODE;
 			p += 3;
 		}
-		p = skip_ws( p );
-		if ( *p == '%' ) { /* commented out line */
+		while ( p < end && is_ws( *p ) ) p++;
+		if ( p < end && *p == '%' ) { /* commented out line */
 			str_empty( line );
 			continue;
 		}
-		if ( *p == '@' ) haveref++;
+		if ( p < end && *p == '@' ) haveref++;
 		if ( haveref && haveref<2 ) {
-			str_strcatc( reference, p );
+			if ( p < end ) str_segcat( reference, ( char * ) p, ( char * ) end );
 			str_addchar( reference, '\n' );
 			str_empty( line );
 		} else if ( !haveref ) str_empty( line );
+		else if ( !line->len ) str_segcat( line, ( char * ) start, ( char * ) start + len );
 	
 	}
 	return haveref;
@@ -141,6 +140,7 @@ typedef struct loc {
 	const char *progname;
 	const char *filename;
 	long nref;
+	param *pm;
 } loc;
 
 /* process_bibtextype()
@@ -380,9 +380,10 @@ token_is_escaped( str *s )
  * do bibtex string replacement for data tokens
  */
 static int
-replace_strings( slist *tokens )
+replace_strings( slist *tokens, param *pm )
 {
-	int i, n;
+	long n;
+	int i;
 	str *s;
 
 	for ( i=0; i<tokens->n; ++i ) {
@@ -395,10 +396,10 @@ replace_strings( slist *tokens )
 		/* ...skip if token is string concatentation symbol */
 		if ( !str_strcmpc( s, "#" ) ) continue;
 
-		n = slist_find( &find, s );
-		if ( slist_wasnotfound( &find, n ) ) continue;
+		n = strhash_findn( &(pm->stringnames), s->data, s->len );
+		if ( n==STRHASH_NOTFOUND ) continue;
 
-		str_strcpy( s, slist_str( &replace, n ) );
+		str_strcpy( s, slist_str( &(pm->stringvalues), n ) );
 		if ( str_memerr( s ) ) return BIBL_ERR_MEMERR;
 
 	}
@@ -517,7 +518,7 @@ process_bibtexline( const char *p, str *tag, str *data, uchar stripquotes, loc *
 	}
 
 	if ( p ) {
-		status = replace_strings( &tokens );
+		status = replace_strings( &tokens, currloc->pm );
 		if ( status!=BIBL_OK ) p = NULL;
 	}
 
@@ -588,8 +589,11 @@ out:
 static int
 process_string( const char *p, loc *currloc )
 {
-	int n, status = BIBL_OK;
+	slist *values = &(currloc->pm->stringvalues);
+	strhash *names = &(currloc->pm->stringnames);
+	int status = BIBL_OK;
 	str s1, s2, *t;
+	long n;
 
 	strs_init( &s1, &s2, NULL );
 
@@ -606,14 +610,16 @@ process_string( const char *p, loc *currloc )
 	}
 
 	if ( str_has_value( &s1 ) ) {
-		n = slist_find( &find, &s1 );
-		if ( n==-1 ) {
-			status = slist_add_ret( &find,    &s1, BIBL_OK, BIBL_ERR_MEMERR );
-			if ( status!=BIBL_OK ) goto out;
-			status = slist_add_ret( &replace, &s2, BIBL_OK, BIBL_ERR_MEMERR );
+		n = strhash_findn( names, s1.data, s1.len );
+		if ( n==STRHASH_NOTFOUND ) {
+			status = slist_add_ret( values, &s2, BIBL_OK, BIBL_ERR_MEMERR );
 			if ( status!=BIBL_OK ) goto out;
+			if ( strhash_addn( names, s1.data, s1.len, values->n-1 )!=STRHASH_OK ) {
+				status = BIBL_ERR_MEMERR;
+				goto out;
+			}
 		} else {
-			t = slist_set( &replace, n, &s2 );
+			t = slist_set( values, n, &s2 );
 			if ( t==NULL ) { status = BIBL_ERR_MEMERR; goto out; }
 		}
 	}
@@ -635,6 +641,7 @@ bibtexin_processf( fields *bibin, const char *data, const char *filename, long n
 	currloc.progname = pm->progname;
 	currloc.filename = filename;
 	currloc.nref     = nref;
+	currloc.pm       = pm;
 
 	if ( !strncasecmp( data, "@STRING", 7 ) ) {
 		process_string( data+7, &currloc );
@@ -653,24 +660,24 @@ bibtexin_processf( fields *bibin, const char *data, const char *filename, long n
 *****************************************************/
 
 static int
-is_url_tag( str *tag )
+is_url_tag( const char *tag )
 {
-	if ( str_has_value( tag ) ) {
-		if ( !strcasecmp( str_cstr( tag ), "url" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "file" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "doi" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "sentelink" ) ) return 1;
+	if ( tag[0] ) {
+		if ( !strcasecmp( tag, "url" ) ) return 1;
+		if ( !strcasecmp( tag, "file" ) ) return 1;
+		if ( !strcasecmp( tag, "doi" ) ) return 1;
+		if ( !strcasecmp( tag, "sentelink" ) ) return 1;
 	}
 	return 0;
 }
 
 static int
-is_name_tag( str *tag )
+is_name_tag( const char *tag )
 {
-	if ( str_has_value( tag ) ) {
-		if ( !strcasecmp( str_cstr( tag ), "author" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "editor" ) ) return 1;
-		if ( !strcasecmp( str_cstr( tag ), "translator" ) ) return 1;
+	if ( tag[0] ) {
+		if ( !strcasecmp( tag, "author" ) ) return 1;
+		if ( !strcasecmp( tag, "editor" ) ) return 1;
+		if ( !strcasecmp( tag, "translator" ) ) return 1;
 	}
 	return 0;
 }
@@ -719,10 +726,10 @@ bibtex_matches_asis_or_corps( fields *bibin, int m, param *pm, int *match )
 {
 	int status;
 
-	status = bibtex_matches_list( bibin, fields_tag( bibin, m, FIELDS_STRP ), ":ASIS", fields_value( bibin, m, FIELDS_STRP ), LEVEL_MAIN, &(pm->asis), match );
+	status = bibtex_matches_list( bibin, fields_tag( bibin, m, FIELDS_CHRP ), ":ASIS", fields_value( bibin, m, FIELDS_STRP ), LEVEL_MAIN, &(pm->asis), match );
 	if ( *match==1 || status!=BIBL_OK ) return status;
 
-	status = bibtex_matches_list( bibin, fields_tag( bibin, m, FIELDS_STRP ), ":CORP", fields_value( bibin, m, FIELDS_STRP ), LEVEL_MAIN, &(pm->corps), match );
+	status = bibtex_matches_list( bibin, fields_tag( bibin, m, FIELDS_CHRP ), ":CORP", fields_value( bibin, m, FIELDS_STRP ), LEVEL_MAIN, &(pm->corps), match );
 	if ( *match==1 || status!=BIBL_OK ) return status;
 
 	return BIBL_OK;
@@ -832,7 +839,8 @@ static int
 bibtexin_cleanref( fields *bibin, param *pm )
 {
 	int i, n, fstatus, status = BIBL_OK;
-	str *tag, *value;
+	const char *tag;
+	str *value;
 	intlist toremove;
 
 	intlist_init( &toremove );
@@ -841,7 +849,7 @@ bibtexin_cleanref( fields *bibin, param *pm )
 
 	for ( i=0; i<n; ++i ) {
 
-		tag = fields_tag( bibin, i, FIELDS_STRP_NOUSE );
+		tag = fields_tag( bibin, i, FIELDS_CHRP_NOUSE );
 		if ( is_url_tag( tag ) ) continue; /* protect url from parsing */
 
 		value = fields_value( bibin, i, FIELDS_STRP_NOUSE );
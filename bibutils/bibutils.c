@@ -16,6 +16,13 @@ bibl_initparams( param *p, int readmode, int writemode, char *progname )
 {
 	int status;
 
+	strhash_init( &(p->stringnames), STRHASH_CASE );
+	slist_init( &(p->stringvalues) );
+
+	p->nthreads = 1;
+	p->usearena = 0;
+	bibl_clearstats( p );
+
 	switch ( readmode ) {
 	case BIBL_BIBTEXIN:     status = bibtexin_initparams  ( p, progname ); break;
 	case BIBL_BIBLATEXIN:   status = biblatexin_initparams( p, progname ); break;
@@ -33,6 +40,8 @@ bibl_initparams( param *p, int readmode, int writemode, char *progname )
 
 	if ( status!=BIBL_OK ) return status;
 
+	if ( p->all ) reftypes_index( p->all, p->nall );
+
 	switch ( writemode ) {
 	case BIBL_ADSABSOUT:   status = adsout_initparams     ( p, progname ); break;
 	case BIBL_BIBTEXOUT:   status = bibtexout_initparams  ( p, progname ); break;
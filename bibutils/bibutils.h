@@ -17,8 +17,10 @@ extern "C" {
 #include "bibdefs.h"
 #include "bibl.h"
 #include "slist.h"
+#include "strhash.h"
 #include "charsets.h"
 #include "str_conv.h"
+#include "inbuf.h"
 
 #define BIBL_FIRSTIN      (100)
 #define BIBL_MODSIN       (BIBL_FIRSTIN)
@@ -78,6 +80,32 @@ extern "C" {
 
 typedef unsigned char uchar;
 
+/* Stages timed by bibl_read() and bibl_write() */
+#define BIBL_STAGE_READ          (0)  /* readf/processf */
+#define BIBL_STAGE_CLEAN         (1)  /* cleanf */
+#define BIBL_STAGE_READCHARSETS  (2)  /* input character set conversion */
+#define BIBL_STAGE_CONVERT       (3)  /* typef/convertf */
+#define BIBL_STAGE_CITEKEYS      (4)  /* unique citekeys and reference counts */
+#define BIBL_STAGE_WRITECHARSETS (5)  /* output character set conversion */
+#define BIBL_STAGE_ASSEMBLE      (6)  /* assemblef */
+#define BIBL_STAGE_WRITE         (7)  /* headerf/writef/footerf */
+#define BIBL_NSTAGES             (8)
+
+/* bibl_stats
+ *
+ * Accumulated over every bibl_read()/bibl_write() made with a param
+ * until bibl_clearstats(). Output bytes are only counted for seekable
+ * streams (files and memory buffers, not pipes). A param may be
+ * shared by threads; use bibl_getstats() rather than reading
+ * param.stats directly while conversions are running.
+ */
+typedef struct bibl_stats {
+	double seconds[BIBL_NSTAGES];  /* wall-clock time spent in stage */
+	long   nrefs[BIBL_NSTAGES];    /* references handled by stage */
+	long   bytesin;
+	long   bytesout;
+} bibl_stats;
+
 typedef struct param {
 
 	int readformat;
@@ -102,24 +130,36 @@ typedef struct param {
 	uchar output_raw;
 	uchar verbose;
 	uchar singlerefperfile;
+	int   nthreads;  /* worker threads for reference conversion, <=1 is serial */
+	uchar usearena;  /* If true, bibl_read() keeps the raw references in an arena */
+
+	bibl_stats stats;
 
 	slist asis;  /* Names that shouldn't be mangled */
 	slist corps; /* Names that shouldn't be mangled-MODS corporation type */
 
+	strhash stringnames;  /* per-read BibTeX @STRING names, index into stringvalues */
+	slist   stringvalues; /* per-read BibTeX @STRING replacement values */
+
 	char *progname;
 
 
-        int  (*readf)(FILE*,char*,int,int*,str*,str*,int*);
-        int  (*processf)(fields*,const char*,const char*,long,struct param*);
-        int  (*cleanf)(bibl*,struct param*);
-        int  (*typef) (fields*,const char*,int,struct param*);
-        int  (*convertf)(fields*,fields*,int,struct param*);
-        void (*headerf)(FILE*,struct param*);
-        void (*footerf)(FILE*);
+	/* readf is the FILE*-based reader of earlier releases; when it
+	 * is set it is used in place of readbuf, so that readers from
+	 * outside the library keep working. The readers here set
+	 * readbuf, which takes its input from an inbuf, see inbuf.h. */
+	int  (*readf)(FILE*,char*,int,int*,str*,str*,int*);
+	int  (*readbuf)(inbuf*,str*,str*,int*);
+	int  (*processf)(fields*,const char*,const char*,long,struct param*);
+	int  (*cleanf)(bibl*,struct param*);
+	int  (*typef) (fields*,const char*,int,struct param*);
+	int  (*convertf)(fields*,fields*,int,struct param*);
+	void (*headerf)(FILE*,struct param*);
+	void (*footerf)(FILE*);
 	int  (*assemblef)(fields*,fields*,struct param*,unsigned long);
-        int  (*writef)(fields*,FILE*,struct param*,unsigned long);
-        variants *all;
-        int  nall;
+	int  (*writef)(fields*,FILE*,struct param*,unsigned long);
+	variants *all;
+	int  nall;
 
 
 } param;
@@ -132,7 +172,24 @@ int  bibl_readcorps( param *p, char *filename );
 int  bibl_addtocorps( param *p, char *entry );
 int  bibl_read( bibl *b, FILE *fp, char *filename, param *p );
 int  bibl_write( bibl *b, FILE *fp, param *p );
+int  bibl_read_mem( bibl *b, const char *buf, size_t len, char *filename, param *p );
+int  bibl_write_mem( bibl *b, char **buf, size_t *len, param *p );
+
+/* bibl_convert_stream() gives the same output as bibl_read() followed
+ * by bibl_write(). When citekeys are made unique or crossrefs have to
+ * be resolved, input that can be seeked is read more than once: up to
+ * four times for BibTeX/BibLaTeX with crossrefs, usually twice
+ * otherwise. Other input is buffered (BibTeX/BibLaTeX) or its
+ * converted references go through a tmpfile() until the whole input
+ * has been read.
+ */
+int  bibl_convert_stream( FILE *in, char *filename, FILE *out, param *rp, param *wp );
+
 void bibl_reporterr( int err );
+void bibl_getstats( param *p, bibl_stats *s );
+void bibl_clearstats( param *p );
+void bibl_reportstats( FILE *fp, param *p );
+const char *bibl_stagename( int stage );
 
 #ifdef __cplusplus
 }
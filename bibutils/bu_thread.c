@@ -0,0 +1,159 @@
+/*
+ * bu_thread.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#include "bu_thread.h"
+
+#ifdef WIN32
+
+/* InitOnceExecuteOnce() and slim reader/writer locks need Vista */
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+#include <stdlib.h>
+
+/* fails to compile if bu_thread.h's stand-ins are the wrong size */
+typedef char bu_once_size  [ sizeof( bu_once_t )==sizeof( INIT_ONCE ) ? 1 : -1 ];
+typedef char bu_mutex_size [ sizeof( bu_mutex_t )==sizeof( SRWLOCK ) ? 1 : -1 ];
+typedef char bu_thread_size[ sizeof( bu_thread_t )==sizeof( HANDLE ) ? 1 : -1 ];
+
+typedef struct bu_oncefn {
+	void (*fn)( void );
+} bu_oncefn;
+
+static BOOL CALLBACK
+bu_once_run( PINIT_ONCE once, PVOID arg, PVOID *ctx )
+{
+	( ( bu_oncefn * ) arg )->fn();
+	return TRUE;
+}
+
+void
+bu_once( bu_once_t *once, void (*fn)( void ) )
+{
+	bu_oncefn f;
+	f.fn = fn;
+	InitOnceExecuteOnce( ( PINIT_ONCE ) once, bu_once_run, &f, NULL );
+}
+
+int
+bu_mutex_init( bu_mutex_t *m )
+{
+	InitializeSRWLock( ( PSRWLOCK ) m );
+	return 0;
+}
+
+void
+bu_mutex_free( bu_mutex_t *m )
+{
+}
+
+void
+bu_mutex_lock( bu_mutex_t *m )
+{
+	AcquireSRWLockExclusive( ( PSRWLOCK ) m );
+}
+
+void
+bu_mutex_unlock( bu_mutex_t *m )
+{
+	ReleaseSRWLockExclusive( ( PSRWLOCK ) m );
+}
+
+typedef struct bu_threadstart {
+	void *(*fn)( void * );
+	void *arg;
+} bu_threadstart;
+
+/* _beginthreadex() rather than CreateThread() so the C runtime is set
+ * up for the new thread
+ */
+static unsigned __stdcall
+bu_thread_run( void *p )
+{
+	bu_threadstart s = *( ( bu_threadstart * ) p );
+	free( p );
+	s.fn( s.arg );
+	return 0;
+}
+
+int
+bu_thread_create( bu_thread_t *t, void *(*fn)( void * ), void *arg )
+{
+	bu_threadstart *s;
+	uintptr_t h;
+
+	s = ( bu_threadstart * ) malloc( sizeof( bu_threadstart ) );
+	if ( !s ) return -1;
+	s->fn  = fn;
+	s->arg = arg;
+
+	h = _beginthreadex( NULL, 0, bu_thread_run, s, 0, NULL );
+	if ( !h ) {
+		free( s );
+		return -1;
+	}
+
+	*t = ( bu_thread_t ) h;
+	return 0;
+}
+
+void
+bu_thread_join( bu_thread_t t )
+{
+	WaitForSingleObject( ( HANDLE ) t, INFINITE );
+	CloseHandle( ( HANDLE ) t );
+}
+
+#else
+
+void
+bu_once( bu_once_t *once, void (*fn)( void ) )
+{
+	pthread_once( once, fn );
+}
+
+int
+bu_mutex_init( bu_mutex_t *m )
+{
+	return pthread_mutex_init( m, NULL );
+}
+
+void
+bu_mutex_free( bu_mutex_t *m )
+{
+	pthread_mutex_destroy( m );
+}
+
+void
+bu_mutex_lock( bu_mutex_t *m )
+{
+	pthread_mutex_lock( m );
+}
+
+void
+bu_mutex_unlock( bu_mutex_t *m )
+{
+	pthread_mutex_unlock( m );
+}
+
+int
+bu_thread_create( bu_thread_t *t, void *(*fn)( void * ), void *arg )
+{
+	return pthread_create( t, NULL, fn, arg );
+}
+
+void
+bu_thread_join( bu_thread_t t )
+{
+	pthread_join( t, NULL );
+}
+
+#endif
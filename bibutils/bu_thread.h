@@ -0,0 +1,54 @@
+/*
+ * bu_thread.h
+ *
+ * The few threading primitives bibutils needs: run-once initialization,
+ * mutexes and joinable threads. POSIX threads everywhere but WIN32,
+ * where the native Win32 calls are used instead.
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef BU_THREAD_H
+#define BU_THREAD_H
+
+#ifdef WIN32
+
+#include <stddef.h>
+
+/* Same layout as INIT_ONCE, SRWLOCK and HANDLE; bu_thread.c checks
+ * this, so that <windows.h> doesn't leak into the rest of the library.
+ */
+typedef struct { void *ptr; } bu_once_t;
+typedef struct { void *ptr; } bu_mutex_t;
+typedef void *bu_thread_t;
+
+#define BU_ONCE_INIT  { NULL }
+#define BU_MUTEX_INIT { NULL }
+
+#else
+
+#include <pthread.h>
+
+typedef pthread_once_t  bu_once_t;
+typedef pthread_mutex_t bu_mutex_t;
+typedef pthread_t       bu_thread_t;
+
+#define BU_ONCE_INIT  PTHREAD_ONCE_INIT
+#define BU_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+
+#endif
+
+void bu_once( bu_once_t *once, void (*fn)( void ) );
+
+/* bu_mutex_init() and bu_thread_create() return 0 on success */
+int  bu_mutex_init  ( bu_mutex_t *m );
+void bu_mutex_free  ( bu_mutex_t *m );
+void bu_mutex_lock  ( bu_mutex_t *m );
+void bu_mutex_unlock( bu_mutex_t *m );
+
+int  bu_thread_create( bu_thread_t *t, void *(*fn)( void * ), void *arg );
+void bu_thread_join  ( bu_thread_t t );
+
+#endif
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "bu_thread.h"
 #include "charsets.h"
 
 #define ARRAYSIZE( a )     ( sizeof(a) / sizeof(a[0]) )
@@ -34612,8 +34613,146 @@ charset_lookupchar( int charsetin, char c )
 	return allcharconvert[charsetin].table[uc].unicode;
 }
 
+/* Reverse (Unicode->charset) lookup
+ *
+ * Built for all charsets on first use. Code points below 256 are looked
+ * up directly in low[]; the rest are binary searched in high[], sorted
+ * by unicode. Where a table maps several characters to one code point,
+ * the first one in the table wins, as with the original linear scan.
+ */
+typedef struct reverse_t {
+	short low[256];     /* charset character, -1 if none */
+	convert_t *high;
+	int nhigh;
+	int ascii;          /* bytes 1-127 are ASCII both ways */
+} reverse_t;
+
+typedef struct reverse_entry_t {
+	unsigned int unicode, index;
+	int pos;
+} reverse_entry_t;
+
+static reverse_t *reverse = NULL;
+static bu_once_t reverse_once = BU_ONCE_INIT;
+
+static int
+reverse_entry_comp( const void *v1, const void *v2 )
+{
+	const reverse_entry_t *e1 = ( const reverse_entry_t * ) v1;
+	const reverse_entry_t *e2 = ( const reverse_entry_t * ) v2;
+
+	if ( e1->unicode < e2->unicode ) return -1;
+	if ( e1->unicode > e2->unicode ) return 1;
+	return e1->pos - e2->pos;
+}
+
+static int
+reverse_build_charset( reverse_t *r, allcharconvert_t *c )
+{
+	reverse_entry_t *e;
+	int i, n = 0;
+
+	for ( i=0; i<256; ++i ) r->low[i] = -1;
+	r->high  = NULL;
+	r->nhigh = 0;
+
+	e = ( reverse_entry_t * ) malloc( sizeof( reverse_entry_t ) * ( c->ntable + 1 ) );
+	if ( !e ) return 0;
+
+	for ( i=0; i<c->ntable; ++i ) {
+		if ( c->table[i].unicode < 256 ) {
+			if ( r->low[ c->table[i].unicode ]==-1 )
+				r->low[ c->table[i].unicode ] = c->table[i].index;
+		} else {
+			e[n].unicode = c->table[i].unicode;
+			e[n].index   = c->table[i].index;
+			e[n].pos     = i;
+			n++;
+		}
+	}
+
+	r->ascii = ( c->ntable >= 128 );
+	for ( i=1; i<128 && r->ascii; ++i )
+		if ( c->table[i].unicode!=( unsigned int ) i || r->low[i]!=i ) r->ascii = 0;
+
+	qsort( e, n, sizeof( reverse_entry_t ), reverse_entry_comp );
+
+	r->high = ( convert_t * ) malloc( sizeof( convert_t ) * ( n + 1 ) );
+	if ( !r->high ) {
+		free( e );
+		return 0;
+	}
+
+	for ( i=0; i<n; ++i ) {
+		if ( r->nhigh && r->high[r->nhigh-1].unicode==e[i].unicode ) continue;
+		r->high[r->nhigh].unicode = e[i].unicode;
+		r->high[r->nhigh].index   = e[i].index;
+		r->nhigh++;
+	}
+
+	free( e );
+	return 1;
+}
+
+static void
+reverse_build( void )
+{
+	reverse_t *r;
+	int i;
+
+	r = ( reverse_t * ) malloc( sizeof( reverse_t ) * nallcharconvert );
+	if ( !r ) return;
+
+	for ( i=0; i<nallcharconvert; ++i ) {
+		if ( !reverse_build_charset( &(r[i]), &(allcharconvert[i]) ) ) {
+			while ( i>=0 ) free( r[i--].high );
+			free( r );
+			return;
+		}
+	}
+
+	reverse = r;
+}
+
+static int
+reverse_lookup( reverse_t *r, unsigned int unicode )
+{
+	int min = 0, max = r->nhigh, mid;
+
+	if ( unicode < 256 ) return r->low[unicode];
+
+	while ( min < max ) {
+		mid = ( min + max ) / 2;
+		if ( r->high[mid].unicode < unicode ) min = mid + 1;
+		else max = mid;
+	}
+	if ( min < r->nhigh && r->high[min].unicode==unicode )
+		return r->high[min].index;
+
+	return -1;
+}
+
 unsigned int
 charset_lookupuni( int charsetout, unsigned int unicode )
+{
+	int i;
+	if ( charsetout==CHARSET_UNICODE ) return unicode;
+	bu_once( &reverse_once, reverse_build );
+	if ( reverse ) {
+		i = reverse_lookup( &(reverse[charsetout]), unicode );
+		return ( i==-1 ) ? '?' : ( unsigned int ) i;
+	}
+	/* couldn't build the reverse tables, fall back on a linear scan */
+	return charset_lookupuni_scan( charsetout, unicode );
+}
+
+/* charset_lookupuni_scan()
+ *
+ * The linear scan that charset_lookupuni() replaces, kept as the
+ * reference for what it has to return.
+ */
+unsigned int
+charset_lookupuni_scan( int charsetout, unsigned int unicode )
 {
 	int i;
 	if ( charsetout==CHARSET_UNICODE ) return unicode;
@@ -34624,3 +34763,17 @@ charset_lookupuni( int charsetout, unsigned int unicode )
 	return '?';
 }
 
+/* charset_asciicompatible()
+ *
+ * Returns 1 if charset_lookupchar() and charset_lookupuni() leave
+ * bytes 1-127 alone for charset n, 0 if not (or if it can't tell).
+ */
+int
+charset_asciicompatible( int n )
+{
+	if ( n==CHARSET_UNICODE || n==CHARSET_GB18030 ) return 1;
+	if ( n<0 || n>=nallcharconvert ) return 0;
+	bu_once( &reverse_once, reverse_build );
+	if ( !reverse ) return 0;
+	return reverse[n].ascii;
+}
@@ -16,10 +16,14 @@
 #define CHARSET_UTF8_DEFAULT (1)
 #define CHARSET_BOM_DEFAULT  (1)
 
+extern int nallcharconvert;
+
 extern char * charset_get_xmlname( int n );
 extern int charset_find( char *name );
 extern void charset_list_all( FILE *fp );
 extern unsigned int charset_lookupchar( int charsetin, char c );
 extern unsigned int charset_lookupuni( int charsetout, unsigned int unicode );
+extern unsigned int charset_lookupuni_scan( int charsetout, unsigned int unicode );
+extern int charset_asciicompatible( int n );
 
 #endif
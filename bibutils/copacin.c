@@ -26,7 +26,7 @@ extern int copac_nall;
  PUBLIC: void copacin_initparams()
 *****************************************************/
 
-static int copacin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int copacin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int copacin_processf( fields *bibin, const char *p, const char *filename, long nref, param *pm );
 static int copacin_convertf( fields *bibin, fields *info, int reftype, param *pm );
 
@@ -44,7 +44,8 @@ copacin_initparams( param *pm, const char *progname )
 	pm->addcount         = 0;
 	pm->output_raw       = 0;
 
-	pm->readf    = copacin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = copacin_readf;
 	pm->processf = copacin_processf;
 	pm->cleanf   = NULL;
 	pm->typef    = NULL;
@@ -86,19 +87,19 @@ copacin_istag( const char *buf )
 	return 1; 
 }
 static int
-readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
+readmore( inbuf *in, str *line )
 {
 	if ( line->len ) return 1;
-	else return str_fget( fp, buf, bufsize, bufpos, line );
+	else return inbuf_getstr( in, line );
 }
 
 static int
-copacin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+copacin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	int haveref = 0, inref=0;
 	char *p;
 	*fcharset = CHARSET_UNKNOWN;
-	while ( !haveref && readmore( fp, buf, bufsize, bufpos, line ) ) {
+	while ( !haveref && readmore( in, line ) ) {
 		/* blank line separates */
 		if ( line->data==NULL ) continue;
 		if ( inref && line->len==0 ) haveref=1; 
@@ -18,7 +18,7 @@
 #include "xml_encoding.h"
 #include "bibformats.h"
 
-static int ebiin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int ebiin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int ebiin_processf( fields *ebiin, const char *data, const char *filename, long nref, param *p );
 
 
@@ -40,7 +40,8 @@ ebiin_initparams( param *pm, const char *progname )
 	pm->output_raw       = BIBL_RAW_WITHMAKEREFID |
 	                       BIBL_RAW_WITHCHARCONVERT;
 
-	pm->readf    = ebiin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = ebiin_readf;
 	pm->processf = ebiin_processf;
 	pm->cleanf   = NULL;
 	pm->typef    = NULL;
@@ -64,13 +65,13 @@ ebiin_initparams( param *pm, const char *progname )
  PUBLIC: int ebiin_readf()
 *****************************************************/
 static int
-ebiin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+ebiin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	int haveref = 0, inref = 0, file_charset = CHARSET_UNKNOWN, m;
 	char *startptr = NULL, *endptr;
 	str tmp;
 	str_init( &tmp );
-	while ( !haveref && str_fget( fp, buf, bufsize, bufpos, line ) ) {
+	while ( !haveref && inbuf_getstr( in, line ) ) {
 		if ( line->data ) {
 			m = xml_getencoding( line );
 			if ( m!=CHARSET_UNKNOWN ) file_charset = m;
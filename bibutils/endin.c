@@ -26,7 +26,7 @@ extern int end_nall;
  PUBLIC: void endin_initparams()
 *****************************************************/
 
-static int endin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int endin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int endin_processf( fields *endin, const char *p, const char *filename, long nref, param *pm );
 int endin_typef( fields *endin, const char *filename, int nrefs, param *p );
 int endin_convertf( fields *endin, fields *info, int reftype, param *p );
@@ -46,7 +46,8 @@ endin_initparams( param *pm, const char *progname )
 	pm->addcount         = 0;
 	pm->output_raw       = 0;
 
-	pm->readf    = endin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = endin_readf;
 	pm->processf = endin_processf;
 	pm->cleanf   = endin_cleanf;
 	pm->typef    = endin_typef;
@@ -89,20 +90,20 @@ endin_istag( const char *buf )
 }
 
 static int
-readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
+readmore( inbuf *in, str *line )
 {
 	if ( line->len ) return 1;
-	else return str_fget( fp, buf, bufsize, bufpos, line );
+	else return inbuf_getstr( in, line );
 }
 
 static int
-endin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+endin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	int haveref = 0, inref = 0;
 	unsigned char *up;
 	char *p;
 	*fcharset = CHARSET_UNKNOWN;
-	while ( !haveref && readmore( fp, buf, bufsize, bufpos, line ) ) {
+	while ( !haveref && readmore( in, line ) ) {
 
 		if ( !line->data ) continue;
 		p = &(line->data[0]);
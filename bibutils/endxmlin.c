@@ -25,7 +25,7 @@ typedef struct {
 extern variants end_all[];
 extern int end_nall;
 
-static int endxmlin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int endxmlin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int endxmlin_processf( fields *endin, const char *p, const char *filename, long nref, param *pm );
 extern int endin_typef( fields *endin, const char *filename, int nrefs, param *p );
 extern int endin_convertf( fields *endin, fields *info, int reftype, param *p );
@@ -49,7 +49,8 @@ endxmlin_initparams( param *pm, const char *progname )
 	pm->addcount         = 0;
 	pm->output_raw       = 0;
 
-	pm->readf    = endxmlin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = endxmlin_readf;
 	pm->processf = endxmlin_processf;
 	pm->cleanf   = NULL;
 	pm->typef    = endin_typef;
@@ -74,14 +75,18 @@ endxmlin_initparams( param *pm, const char *progname )
 *****************************************************/
 
 static int
-xml_readmore( FILE *fp, char *buf, int bufsize, int *bufpos )
+xml_readmore( inbuf *in, str *line )
 {
-	if ( !feof( fp ) && fgets( buf, bufsize, fp ) ) return 0;
-	return 1;
+	const char *p;
+	size_t n;
+
+	if ( !inbuf_getraw( in, &p, &n ) ) return 1;
+	str_segcat( line, ( char * ) p, ( char * ) p + n );
+	return 0;
 }
 
 static int
-endxmlin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+endxmlin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	int haveref = 0, inref = 0, done = 0, file_charset = CHARSET_UNKNOWN, m;
 	char *startptr = NULL, *endptr = NULL;
@@ -92,8 +97,7 @@ endxmlin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *r
 	while ( !haveref && !done ) {
 
 		if ( str_is_empty( line ) ) {
-			done = xml_readmore( fp, buf, bufsize, bufpos );
-			str_strcatc( line, buf );
+			done = xml_readmore( in, line );
 		}
 
 		if ( !inref ) {
@@ -117,8 +121,7 @@ endxmlin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *r
 
 		/* ...entire reference is not in line, read more */
 		if ( !startptr || !endptr ) {
-			done = xml_readmore( fp, buf, bufsize, bufpos );
-			str_strcatc( line, buf );
+			done = xml_readmore( in, line );
 		}
 		/* ...we can reallocate in str_strcat; must re-find the tags */
 		else {
@@ -9,6 +9,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include "bu_thread.h"
+#include "strhash.h"
 #include "entities.h"
 
 /* HTML 4.0 entities */
@@ -282,77 +284,95 @@ entities html_entities[] = {
 };
 
 
-static unsigned int
-decode_html_entity( char *s, unsigned int *pi, int *err )
+/* html_entities[] hashed on the whole "&name;" string, ignoring case;
+ * strhash_add() keeps the first of entries differing only in case, as
+ * the linear scan did
+ */
+static strhash html_hash;
+static unsigned long html_maxlen = 0;
+static int html_hash_ok = 0;
+static bu_once_t html_hash_once = BU_ONCE_INIT;
+
+static void
+html_hash_build( void )
 {
 	int nhtml_entities = sizeof( html_entities ) / sizeof( entities );
-	char *e;
-	int i, n=-1, len;
-	for ( i=0; i<nhtml_entities && n==-1; ++i ) {
-		e = &(html_entities[i].html[0]);
-		len = strlen( e );
-		if ( !strncasecmp( &(s[*pi]), e, len ) ) {
-			n = i;
-			*pi += len;
+	unsigned long len;
+	int i;
+
+	strhash_init( &html_hash, STRHASH_NOCASE );
+
+	for ( i=0; i<nhtml_entities; ++i ) {
+		len = strlen( html_entities[i].html );
+		if ( strhash_addn( &html_hash, html_entities[i].html, len, i )!=STRHASH_OK ) {
+			strhash_free( &html_hash );
+			return;
 		}
+		if ( len > html_maxlen ) html_maxlen = len;
 	}
-	if ( n==-1 ) {
-		*err = 1;
-		return '&';
-	} else {
-		*err = 0;
-		return html_entities[n].unicode;
-	}
-}
 
+	html_hash_ok = 1;
+}
 
-/*
- * decode decimal entity
+/* find_html_entity()
  *
- *    extract a decimal entity from &#NNNN;
- *    s[*pi] points to the '&' character
+ * Every entry is "&name;" with an alphanumeric name, so the only one
+ * that can match is the run up to the first ';'.
  */
-static unsigned int
-decode_decimal_entity( char *s, unsigned int *pi, int *err )
+static int
+find_html_entity( char *s, unsigned int *len )
 {
-	unsigned int c = 0, d;
-	int i = *pi, j = 2;
-	while ( isdigit( (unsigned char)s[i+j] ) ) {
-		d = s[i+j] - '0';
-		c = 10 * c + d;
-		j++;
+	int nhtml_entities = sizeof( html_entities ) / sizeof( entities );
+	unsigned long n;
+	char *e;
+	int i;
+
+	bu_once( &html_hash_once, html_hash_build );
+
+	if ( html_hash_ok ) {
+		for ( n=1; n<html_maxlen && s[n] && s[n]!=';'; ++n ) ;
+		if ( n==html_maxlen || s[n]!=';' ) return -1;
+		i = strhash_findn( &html_hash, s, n+1 );
+		if ( i!=STRHASH_NOTFOUND ) *len = n+1;
+		return i;
 	}
-	if ( s[i+j]!=';' ) *err = 1;
-	else *pi = i+j+1;
-	return c;
+
+	/* couldn't build the hash, scan the table */
+	for ( i=0; i<nhtml_entities; ++i ) {
+		e = &(html_entities[i].html[0]);
+		n = strlen( e );
+		if ( !strncasecmp( s, e, n ) ) {
+			*len = n;
+			return i;
+		}
+	}
+
+	return -1;
 }
 
-/*
- * decode hex entity
- *
- *    extract a hex entity from &#xNNNN;
- *    s[*pi] points to the '&' character
- */
 static unsigned int
-decode_hex_entity( char *s, unsigned int *pi, int *err )
+decode_html_entity( char *s, unsigned int *pi, int *err )
 {
-	unsigned int c = 0, d;
-	int i = *pi, j = 3;
-	while ( isxdigit( (unsigned char)s[i+j] ) ) {
-		if ( isdigit( (unsigned char)s[i+j] ) ) d = s[i+j]-'0';
-		else d = toupper((unsigned char)s[i+j])-'A' + 10;
-		c = 16 * c + d;
-		j++;
+	unsigned int len;
+	int n;
+
+	n = find_html_entity( &(s[*pi]), &len );
+	if ( n==-1 ) {
+		*err = 1;
+		return '&';
+	} else {
+		*err = 0;
+		*pi += len;
+		return html_entities[n].unicode;
 	}
-	if ( s[i+j]!=';' ) *err = 1;
-	else *pi = i+j+1;
-	return c;
 }
 
+
 /*
  * decode numeric entity
  *
  *    extract a numeric entity from &#NNN; or &#xNNNN;
+ *    s[*pi] points to the '&' character
  *
  *    In XML, the "x" in hexadecimal entries should be lowercase,
  *    but we'll be generous and accept "X" as well.
@@ -360,14 +380,33 @@ decode_hex_entity( char *s, unsigned int *pi, int *err )
 static unsigned int
 decode_numeric_entity( char *s, unsigned int *pi, int *err )
 {
-	unsigned int c;
-	*err = 0;
-	if ( s[*pi+2]!='x' && s[*pi+2]!='X' ) c = decode_decimal_entity( s, pi, err );
-	else c = decode_hex_entity( s, pi, err );
-	if ( *err ) {
+	unsigned int c = 0, d, base = 10;
+	char *p = &(s[*pi+2]);
+	unsigned char ch;
+
+	if ( *p=='x' || *p=='X' ) {
+		base = 16;
+		p++;
+	}
+
+	while ( 1 ) {
+		ch = ( unsigned char ) *p;
+		if ( ch>='0' && ch<='9' ) d = ch - '0';
+		else if ( base==16 && ch>='a' && ch<='f' ) d = ch - 'a' + 10;
+		else if ( base==16 && ch>='A' && ch<='F' ) d = ch - 'A' + 10;
+		else break;
+		c = base * c + d;
+		p++;
+	}
+
+	if ( *p!=';' ) {
+		*err = 1;
 		*pi = *pi + 1;
-		c = '&';
+		return '&';
 	}
+
+	*err = 0;
+	*pi = ( unsigned int ) ( p - s ) + 1;
 	return c;
 }
 
@@ -10,10 +10,14 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include "strhash.h"
 #include "fields.h"
 
 #define FIELDS_MIN_ALLOC (20)
 
+/* records with at least this many entries get a duplicate-check index */
+#define FIELDS_DUPINDEX_MIN (32)
+
 /* private helper macros to access fields
  *
  * These skip all of the error checking and used flag manipulation
@@ -27,6 +31,8 @@
 #define _fields_value_char(f,i)     str_cstr( &((f)->value[(i)]) )
 #define _fields_value_notempty(f,i) str_has_value( &((f)->value[(i)]) )
 #define _fields_level(f,i)          (f)->level[(i)]
+#define _fields_taghash(f,i)        (f)->taghash[(i)]
+#define _fields_tagout(f,i)         ( (i)>=(f)->tagout_lo && (i)<=(f)->tagout_hi )
 
 fields*
 fields_new( void )
@@ -36,36 +42,192 @@ fields_new( void )
 	return f;
 }
 
+/* fields_newarena()
+ *
+ * Allocate a fields, its arrays and its tag/value strs from a child
+ * of parent. They are released with parent; fields_free()/fields_delete()
+ * only release strs that have since been swapped for heap ones.
+ */
+fields*
+fields_newarena( arena *parent )
+{
+	arena *mem;
+	fields *f;
+
+	mem = arena_newchild( parent );
+	if ( !mem ) return NULL;
+
+	f = ( fields * ) arena_alloc( mem, sizeof( fields ) );
+	if ( f ) {
+		fields_init( f );
+		f->mem = mem;
+	}
+	return f;
+}
+
 void
 fields_init( fields *f )
 {
 	f->used  = f->level = NULL;
 	f->tag   = f->value = NULL;
+	f->taghash = NULL;
 	f->max   = f->n     = 0;
+	f->dupindex = NULL;
+	f->dupindex_max = 0;
+	f->dupindex_dim = 0;
+	f->dupindex_n = 0;
+	f->valueout_lo = 0;
+	f->valueout_hi = -1;
+	f->tagout_lo = 0;
+	f->tagout_hi = -1;
+	f->mem = NULL;
 }
 
 void
 fields_free( fields *f )
 {
+	arena *mem = f->mem;
 	int i;
 
 	for ( i=0; i<f->max; ++i ) {
 		str_free( _fields_tag( f, i ) );
 		str_free( _fields_value( f, i ) );
 	}
-	if ( f->tag )   free( f->tag );
-	if ( f->value ) free( f->value );
-	if ( f->used )  free( f->used );
-	if ( f->level ) free( f->level );
+	if ( !mem ) {
+		if ( f->tag )   free( f->tag );
+		if ( f->value ) free( f->value );
+		if ( f->taghash ) free( f->taghash );
+		if ( f->used )  free( f->used );
+		if ( f->level ) free( f->level );
+		if ( f->dupindex ) free( f->dupindex );
+	}
 
 	fields_init( f );
+	f->mem = mem;
 }
 
 void
 fields_delete( fields *f )
 {
 	fields_free( f );
-	free( f );
+	if ( !f->mem ) free( f );
+}
+
+/* Duplicate-check index
+ *
+ * With FIELDS_NO_DUPS, _fields_add() has to compare the new entry
+ * against every existing one. Once a record reaches FIELDS_DUPINDEX_MIN
+ * entries, positions are also kept in an open-addressing table keyed
+ * on (level, tag, value) folded to lower case, so that the check only
+ * looks at entries with the same key hash.
+ *
+ * Entries can be changed in place through the str pointers handed out
+ * by fields_value()/fields_tag() with FIELDS_STRP_FLAG, at any time
+ * after they were handed out, so the slots of those entries may be
+ * keyed on old contents. The ranges of entries handed out that way
+ * (tagout_lo...tagout_hi, valueout_lo...valueout_hi) are therefore
+ * always checked one by one as well, see is_duplicate_entry_indexed().
+ * Slots are only ever compared against the live entries, so a stale
+ * one can't match wrongly. fields_replace_or_add() puts the entry it
+ * changes in the table again; its old slot is left behind and only
+ * counts against the load factor until the next rebuild. Removing an
+ * entry moves the ones after it, so that drops the index; it is
+ * rebuilt by the next FIELDS_NO_DUPS add.
+ *
+ * The table is kept across drops, so that rebuilding it doesn't take
+ * more memory; it is released by fields_free().
+ */
+static void
+fields_dupindex_drop( fields *f )
+{
+	f->dupindex_max = 0;
+}
+
+static unsigned long
+fields_dupindex_hash( unsigned long taghash, const char *value, int level )
+{
+	unsigned long hash;
+
+	hash = strhash_hash( value, strlen( value ), STRHASH_NOCASE );
+	hash ^= taghash + 0x9e3779b9UL + ( hash << 6 ) + ( hash >> 2 );
+	hash ^= ( unsigned long ) level * 16777619UL;
+
+	return hash;
+}
+
+static void
+fields_dupindex_put( fields *f, int n, unsigned long hash )
+{
+	unsigned long mask = f->dupindex_max - 1;
+	unsigned long pos = hash & mask;
+
+	while ( f->dupindex[pos]!=-1 )
+		pos = ( pos + 1 ) & mask;
+
+	f->dupindex[pos] = n;
+	f->dupindex_n++;
+}
+
+static unsigned long
+fields_dupindex_entryhash( fields *f, int n )
+{
+	char *value;
+
+	value = _fields_value_char( f, n );
+	if ( !value ) value = "";
+
+	return fields_dupindex_hash( _fields_taghash( f, n ), value, _fields_level( f, n ) );
+}
+
+static int
+fields_dupindex_build( fields *f, int max )
+{
+	int i;
+
+	fields_dupindex_drop( f );
+
+	if ( f->dupindex_dim < max ) {
+		if ( f->mem ) f->dupindex = ( int * ) arena_alloc( f->mem, sizeof( int ) * max );
+		else {
+			if ( f->dupindex ) free( f->dupindex );
+			f->dupindex = ( int * ) malloc( sizeof( int ) * max );
+		}
+		if ( !f->dupindex ) {
+			f->dupindex_dim = 0;
+			return FIELDS_ERR_MEMERR;
+		}
+		f->dupindex_dim = max;
+	}
+	for ( i=0; i<max; ++i ) f->dupindex[i] = -1;
+	f->dupindex_max = max;
+	f->dupindex_n = 0;
+
+	for ( i=0; i<f->n; ++i )
+		fields_dupindex_put( f, i, fields_dupindex_entryhash( f, i ) );
+
+	return FIELDS_OK;
+}
+
+/* fields_dupindex_ensure()
+ *
+ * Make sure the index, if the record is large enough to need one, has
+ * room for one more entry. Returns 1 if the index is in use.
+ */
+static int
+fields_dupindex_ensure( fields *f )
+{
+	int max;
+
+	if ( f->n + 1 < FIELDS_DUPINDEX_MIN ) return 0;
+
+	if ( f->dupindex_max && ( f->dupindex_n + 1 ) * 2 <= f->dupindex_max ) return 1;
+
+	max = f->dupindex_max ? f->dupindex_max : 2 * FIELDS_DUPINDEX_MIN;
+	while ( ( f->n + 1 ) * 2 > max ) max *= 2;
+
+	if ( fields_dupindex_build( f, max )!=FIELDS_OK ) return 0;
+
+	return 1;
 }
 
 int
@@ -73,9 +235,14 @@ fields_remove( fields *f, int n )
 {
 	int i;
 	if ( n<0 || n>= f->n ) return FIELDS_ERR_MEMERR;
+	fields_dupindex_drop( f );
 	for ( i=n+1; i<f->n; ++i ) {
 		str_strcpy( _fields_tag  ( f, i-1 ), _fields_tag  ( f, i ) );
 		str_strcpy( _fields_value( f, i-1 ), _fields_value( f, i ) );
+		if ( _fields_tagout( f, i ) )
+			f->taghash[i-1] = fields_taghash( _fields_tag_char( f, i ) );
+		else
+			f->taghash[i-1] = f->taghash[i];
 		f->used[i-1]  = f->used[i];
 		f->level[i-1] = f->level[i];
 	}
@@ -88,21 +255,52 @@ initialize_new_tag_data_pairs( fields *f, int start, int end )
 {
 	int i;
 	for ( i=start; i<end; ++i ) {
-		str_init( _fields_tag( f, i ) );
-		str_init( _fields_value( f, i ) );
+		str_initarena( _fields_tag( f, i ), f->mem );
+		str_initarena( _fields_value( f, i ), f->mem );
 	}
 }
 
+static int
+fields_alloc_arena( fields *f, int alloc )
+{
+	f->tag   = (str *) arena_alloc( f->mem, sizeof(str) * alloc );
+	f->value = (str *) arena_alloc( f->mem, sizeof(str) * alloc );
+	f->taghash = (unsigned long *) arena_alloc( f->mem, sizeof(unsigned long) * alloc );
+	f->used  = (int *) arena_alloc( f->mem, sizeof(int) * alloc );
+	f->level = (int *) arena_alloc( f->mem, sizeof(int) * alloc );
+	if ( !f->tag || !f->value || !f->taghash || !f->used || !f->level ) {
+		f->tag = f->value = NULL;
+		f->taghash = NULL;
+		f->used = f->level = NULL;
+		return FIELDS_ERR_MEMERR;
+	}
+
+	memset( f->taghash, 0, sizeof(unsigned long) * alloc );
+	memset( f->used,    0, sizeof(int) * alloc );
+	memset( f->level,   0, sizeof(int) * alloc );
+
+	initialize_new_tag_data_pairs( f, 0, alloc );
+
+	f->max = alloc;
+	f->n   = 0;
+
+	return FIELDS_OK;
+}
+
 static int
 fields_alloc( fields *f, int alloc )
 {
+	if ( f->mem ) return fields_alloc_arena( f, alloc );
+
 	f->tag   = (str *) malloc( sizeof(str) * alloc );
 	f->value = (str *) malloc( sizeof(str) * alloc );
+	f->taghash = (unsigned long *) calloc( alloc, sizeof(unsigned long) );
 	f->used  = (int *) calloc( alloc, sizeof(int) );
 	f->level = (int *) calloc( alloc, sizeof(int) );
-	if ( !f->tag || !f->value || !f->used || !f->level ){
+	if ( !f->tag || !f->value || !f->taghash || !f->used || !f->level ){
 		if ( f->tag )   free( f->tag );
 		if ( f->value ) free( f->value );
+		if ( f->taghash ) free( f->taghash );
 		if ( f->used )  free( f->used );
 		if ( f->level ) free( f->level );
 		fields_init( f );
@@ -117,9 +315,49 @@ fields_alloc( fields *f, int alloc )
 	return FIELDS_OK;
 }
 
+/* fields_realloc_arena()
+ *
+ * Arena memory can't grow in place, so copy the arrays into new ones;
+ * the str structs are moved, their buffers stay where they are.
+ */
+static int
+fields_realloc_arena( fields *f, int alloc )
+{
+	unsigned long *newhash;
+	int *newused, *newlevel;
+	str *newtags, *newvalue;
+
+	newtags  = (str*) arena_alloc( f->mem, sizeof(str) * alloc );
+	newvalue = (str*) arena_alloc( f->mem, sizeof(str) * alloc );
+	newhash  = (unsigned long*) arena_alloc( f->mem, sizeof(unsigned long) * alloc );
+	newused  = (int*) arena_alloc( f->mem, sizeof(int) * alloc );
+	newlevel = (int*) arena_alloc( f->mem, sizeof(int) * alloc );
+	if ( !newtags || !newvalue || !newhash || !newused || !newlevel )
+		return FIELDS_ERR_MEMERR;
+
+	memcpy( newtags,  f->tag,     sizeof(str) * f->max );
+	memcpy( newvalue, f->value,   sizeof(str) * f->max );
+	memcpy( newhash,  f->taghash, sizeof(unsigned long) * f->max );
+	memcpy( newused,  f->used,    sizeof(int) * f->max );
+	memcpy( newlevel, f->level,   sizeof(int) * f->max );
+
+	f->tag     = newtags;
+	f->value   = newvalue;
+	f->taghash = newhash;
+	f->used    = newused;
+	f->level   = newlevel;
+
+	initialize_new_tag_data_pairs( f, f->n, alloc );
+
+	f->max = alloc;
+
+	return FIELDS_OK;
+}
+
 static int
 fields_realloc( fields *f )
 {
+	unsigned long *newhash;
 	int *newused, *newlevel;
 	str *newtags, *newvalue;
 	int alloc;
@@ -127,8 +365,11 @@ fields_realloc( fields *f )
 	alloc = f->max * 2;
 	if ( alloc < f->max ) return FIELDS_ERR_MEMERR; /* integer overflow */
 
+	if ( f->mem ) return fields_realloc_arena( f, alloc );
+
 	newtags  = (str*) realloc( f->tag,   sizeof(str) * alloc );
 	newvalue = (str*) realloc( f->value, sizeof(str) * alloc );
+	newhash  = (unsigned long*) realloc( f->taghash, sizeof(unsigned long) * alloc );
 	newused  = (int*) realloc( f->used,  sizeof(int) * alloc );
 	newlevel = (int*) realloc( f->level, sizeof(int) * alloc );
 
@@ -138,10 +379,11 @@ fields_realloc( fields *f )
 	 */
 	if ( newtags )  f->tag   = newtags;
 	if ( newvalue ) f->value = newvalue;
+	if ( newhash )  f->taghash = newhash;
 	if ( newused )  f->used  = newused;
 	if ( newlevel ) f->level = newlevel;
 
-	if ( !newtags || !newvalue || !newused || !newlevel )
+	if ( !newtags || !newvalue || !newhash || !newused || !newlevel )
 		return FIELDS_ERR_MEMERR;
 
 	initialize_new_tag_data_pairs( f, f->n, alloc );
@@ -160,14 +402,36 @@ ensure_space( fields *f )
 	return status;
 }
 
+/* fields_taghash()
+ *
+ * Tags are matched without regard to case, so each one is stored with
+ * a case-folded hash. Lookups compare hashes first and only fall back
+ * to strcasecmp() when they are equal.
+ *
+ * fields_tag() with FIELDS_STRP_FLAG hands out the tag str itself, and
+ * the caller may keep it and edit the tag at any later time, so the
+ * hash of such an entry can't be trusted again. fields_tag() records
+ * the range of entries handed out that way (tagout_lo...tagout_hi) and
+ * those are always compared with strcasecmp().
+ */
+unsigned long
+fields_taghash( const char *tag )
+{
+	return strhash_hash( tag, strlen( tag ), STRHASH_NOCASE );
+}
+
+#define _fields_match_casetag_hash(f,i,tag,hash) \
+	( ( _fields_taghash( (f), (i) )==(hash) || _fields_tagout( (f), (i) ) ) && \
+	  !strcasecmp( _fields_tag_char( (f), (i) ), (tag) ) )
+
 static int
-is_duplicate_entry( fields *f, const char *tag, const char *value, int level )
+is_duplicate_entry_range( fields *f, const char *tag, unsigned long hash, const char *value, int level, int start, int end )
 {
 	int i;
 
-	for ( i=0; i<f->n; i++ ) {
+	for ( i=start; i<end && i<f->n; i++ ) {
 		if ( _fields_level( f, i ) != level ) continue;
-		if ( strcasecmp( _fields_tag_char( f, i ),   tag   ) ) continue;
+		if ( !_fields_match_casetag_hash( f, i, tag, hash ) ) continue;
 		if ( strcasecmp( _fields_value_char( f, i ), value ) ) continue;
 		return 1;
 	}
@@ -175,17 +439,68 @@ is_duplicate_entry( fields *f, const char *tag, const char *value, int level )
 	return 0;
 }
 
+static int
+is_duplicate_entry( fields *f, const char *tag, unsigned long hash, const char *value, int level )
+{
+	return is_duplicate_entry_range( f, tag, hash, value, level, 0, f->n );
+}
+
+/* is_duplicate_entry_indexed()
+ *
+ * Entries handed out with FIELDS_STRP_FLAG may have been edited since
+ * they were put in the table, so a miss there is only trusted once
+ * they have been checked directly.
+ */
+static int
+is_duplicate_entry_indexed( fields *f, const char *tag, unsigned long hash, const char *value, int level, unsigned long duphash )
+{
+	unsigned long mask = f->dupindex_max - 1;
+	unsigned long pos = duphash & mask;
+	int i;
+
+	while ( ( i = f->dupindex[pos] )!=-1 ) {
+		if ( _fields_level( f, i )==level &&
+		     _fields_match_casetag_hash( f, i, tag, hash ) &&
+		     !strcasecmp( _fields_value_char( f, i ), value ) )
+			return 1;
+		pos = ( pos + 1 ) & mask;
+	}
+
+	if ( f->tagout_lo <= f->tagout_hi &&
+	     is_duplicate_entry_range( f, tag, hash, value, level, f->tagout_lo, f->tagout_hi + 1 ) )
+		return 1;
+	if ( f->valueout_lo <= f->valueout_hi &&
+	     is_duplicate_entry_range( f, tag, hash, value, level, f->valueout_lo, f->valueout_hi + 1 ) )
+		return 1;
+
+	return 0;
+}
+
 int
 _fields_add( fields *f, const char *tag, const char *value, int level, int mode )
 {
-	int n, status;
+	unsigned long hash, duphash = 0;
+	int n, status, indexed;
 
 	/* Don't add incomplete entry */
 	if ( !tag || !value ) return FIELDS_OK;
 
+	hash = fields_taghash( tag );
+
+	/* Keep the duplicate-check index (if any) up to date with every add */
+	indexed = ( mode == FIELDS_NO_DUPS || f->dupindex_max ) && fields_dupindex_ensure( f );
+	if ( indexed ) duphash = fields_dupindex_hash( hash, value, level );
+
 	/* Don't add duplicate entry if FIELDS_NO_DUPS */
-	if ( mode == FIELDS_NO_DUPS && is_duplicate_entry( f, tag, value, level ) )
-		return FIELDS_OK;
+	if ( mode == FIELDS_NO_DUPS ) {
+		if ( indexed ) {
+			if ( is_duplicate_entry_indexed( f, tag, hash, value, level, duphash ) )
+				return FIELDS_OK;
+		} else {
+			if ( is_duplicate_entry( f, tag, hash, value, level ) )
+				return FIELDS_OK;
+		}
+	}
 
 	status = ensure_space( f );
 	if ( status!=FIELDS_OK ) return status;
@@ -193,12 +508,15 @@ _fields_add( fields *f, const char *tag, const char *value, int level, int mode
 	n = f->n;
 	f->used[ n ]  = 0;
 	f->level[ n ] = level;
+	f->taghash[ n ] = hash;
 	str_strcpyc( _fields_tag( f, n ),   tag   );
 	str_strcpyc( _fields_value( f, n ), value );
 
 	if ( str_memerr( &(f->tag[n]) ) || str_memerr( &(f->value[n] ) ) )
 		return FIELDS_ERR_MEMERR;
 
+	if ( indexed ) fields_dupindex_put( f, n, duphash );
+
 	f->n++;
 
 	return FIELDS_OK;
@@ -241,15 +559,17 @@ fields_new_size( int alloc )
 	return f;
 }
 
-fields *
-fields_dupl( fields *in )
+/* fields_copy()
+ *
+ * Append every entry of in to out, which may live in an arena.
+ *
+ * returns FIELDS_OK or FIELDS_ERR_MEMERR
+ */
+int
+fields_copy( fields *out, fields *in )
 {
 	int i, level, status;
 	char *tag, *value;
-	fields *out;
-
-	out = fields_new_size( in->n );
-	if ( !out ) return NULL;
 
 	for ( i=0; i<in->n; ++i ) {
 		tag   = _fields_tag_char( in, i );
@@ -257,13 +577,26 @@ fields_dupl( fields *in )
 		level = _fields_level( in, i );
 		if ( tag && value ) {
 			status = fields_add_can_dup( out, tag, value, level );
-			if ( status!=FIELDS_OK ) {
-				fields_delete( out );
-				return NULL;
-			}
+			if ( status!=FIELDS_OK ) return status;
 		}
 	}
 
+	return FIELDS_OK;
+}
+
+fields *
+fields_dupl( fields *in )
+{
+	fields *out;
+
+	out = fields_new_size( in->n );
+	if ( !out ) return NULL;
+
+	if ( fields_copy( out, in )!=FIELDS_OK ) {
+		fields_delete( out );
+		return NULL;
+	}
+
 	return out;
 }
 
@@ -322,11 +655,12 @@ fields_match_casetag_level( fields *f, int n, const char *tag, int level )
 int
 fields_find( fields *f, const char *tag, int level )
 {
+	unsigned long hash = fields_taghash( tag );
 	int i;
 
 	for ( i=0; i<f->n; ++i ) {
-		if ( !fields_match_casetag_level( f, i, tag, level ) )
-			continue;
+		if ( !_fields_match_casetag_hash( f, i, tag, hash ) ) continue;
+		if ( !fields_match_level( f, i, level ) ) continue;
 		if ( str_has_value( _fields_value( f, i ) ) ) return i;
 		else {
 			/* if there is no data for the tag, don't "find" it */
@@ -386,6 +720,10 @@ fields_replace_or_add( fields *f, const char *tag, const char *value, int level
 	else {
 		str_strcpyc( _fields_value( f, n ), value );
 		if ( str_memerr( _fields_value( f, n ) ) ) return FIELDS_ERR_MEMERR;
+		if ( f->dupindex_max ) {
+			if ( ( f->dupindex_n + 1 ) * 2 > f->dupindex_max ) fields_dupindex_drop( f );
+			else fields_dupindex_put( f, n, fields_dupindex_entryhash( f, n ) );
+		}
 		return FIELDS_OK;
 	}
 }
@@ -454,6 +792,8 @@ fields_value( fields *f, int n, int mode )
 		fields_set_used( f, n );
 
 	if ( mode & FIELDS_STRP_FLAG ) {
+		if ( n < f->valueout_lo || f->valueout_hi < f->valueout_lo ) f->valueout_lo = n;
+		if ( n > f->valueout_hi ) f->valueout_hi = n;
 		return ( void * ) _fields_value( f, n );
 	}
 	else if ( mode & FIELDS_POSP_FLAG ) {
@@ -476,6 +816,8 @@ fields_tag( fields *f, int n, int mode )
 	if ( n<0 || n>= f->n ) return NULL;
 
 	if ( mode & FIELDS_STRP_FLAG ) {
+		if ( n < f->tagout_lo || f->tagout_hi < f->tagout_lo ) f->tagout_lo = n;
+		if ( n > f->tagout_hi ) f->tagout_hi = n;
 		return ( void * ) _fields_tag( f, n );
 	}
 	else if ( mode & FIELDS_POSP_FLAG ) {
@@ -500,12 +842,13 @@ fields_level( fields *f, int n )
 void *
 fields_findv( fields *f, int level, int mode, const char *tag )
 {
+	unsigned long hash = fields_taghash( tag );
 	int i, found = FIELDS_NOTFOUND;
 
 	for ( i=0; i<f->n; ++i ) {
 
+		if ( !_fields_match_casetag_hash( f, i, tag, hash ) ) continue;
 		if ( !fields_match_level( f, i, level ) ) continue;
-		if ( !fields_match_casetag( f, i, tag ) ) continue;
 
 		if ( _fields_value_notempty( f, i ) ) {
 			found = i;
@@ -560,12 +903,13 @@ fields_findv_each_add( fields *f, int mode, int n, vplist *a )
 int
 fields_findv_each( fields *f, int level, int mode, vplist *a, const char *tag )
 {
+	unsigned long hash = fields_taghash( tag );
 	int i, status;
 
 	for ( i=0; i<f->n; ++i ) {
 
+		if ( !_fields_match_casetag_hash( f, i, tag, hash ) ) continue;
 		if ( !fields_match_level( f, i, level ) ) continue;
-		if ( !fields_match_casetag( f, i, tag ) ) continue;
 
 		if ( _fields_value_notempty( f, i ) ) {
 			status = fields_findv_each_add( f, mode, i, a );
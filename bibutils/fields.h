@@ -27,15 +27,27 @@
 typedef struct fields {
 	str       *tag;
 	str       *value;
+	unsigned long *taghash; /* case-folded hash of tag, see fields_taghash() */
 	int       *used;
 	int       *level;
 	int       n;
 	int       max;
+	int       *dupindex;    /* FIELDS_NO_DUPS lookup, built for large records */
+	int       dupindex_max; /* size of the lookup table, 0 if there is none */
+	int       dupindex_dim; /* ints allocated at dupindex */
+	int       dupindex_n;   /* slots in use, stale ones included */
+	int       valueout_lo;  /* values handed out with FIELDS_STRP_FLAG, */
+	int       valueout_hi;  /* their dupindex slots may be stale */
+	int       tagout_lo;    /* tags handed out with FIELDS_STRP_FLAG, */
+	int       tagout_hi;    /* their taghash is not used */
+	arena     *mem;         /* if set, arrays and strs are allocated here */
 } fields;
 
 void    fields_init( fields *f );
 fields *fields_new( void );
+fields *fields_newarena( arena *parent );
 fields *fields_dupl( fields *f );
+int     fields_copy( fields *out, fields *in );
 void    fields_delete( fields *f );
 void    fields_free( fields *f );
 
@@ -63,6 +75,8 @@ int fields_no_tag( fields *f, int n );
 int fields_no_value( fields *f, int n );
 int fields_has_value( fields *f, int n );
 
+unsigned long fields_taghash( const char *tag );
+
 int fields_match_level( fields *f, int n, int level );
 int fields_match_tag( fields *f, int n, const char *tag );
 int fields_match_casetag( fields *f, int n, const char *tag );
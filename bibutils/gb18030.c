@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include "bu_thread.h"
 #include "gb18030.h"
 
 /* GB18030-2000 is an encoding of Unicode character used in China
@@ -29,81 +30,170 @@ in_range( unsigned char n, unsigned char low, unsigned char high )
 }
 
 
+/* Four-byte sequences {0x81-0xFE}{0x30-0x39}{0x81-0xFE}{0x30-0x39}
+ * are numbered linearly from GB+81308130 == 0
+ */
+static unsigned int
+gb18030_linear( unsigned char *s )
+{
+	return ( ( ( s[0] - 0x81 ) * 10 + ( s[1] - 0x30 ) ) * 126 + ( s[2] - 0x81 ) ) * 10 + ( s[3] - 0x30 );
+}
+
+static void
+gb18030_fromlinear( unsigned int n, unsigned char out[4] )
+{
+	out[3] = 0x30 + n % 10;  n /= 10;
+	out[2] = 0x81 + n % 126; n /= 126;
+	out[1] = 0x30 + n % 10;  n /= 10;
+	out[0] = 0x81 + n;
+}
+
+/* Roundtrip mappings outside of gb18030_enums[] map Unicode linearly onto
+ * four-byte sequences in these ranges; together with the table they cover
+ * all of U+0080..U+10FFFF except the surrogates.
+ */
+typedef struct grange_t {
+	unsigned int ufirst, ulast;
+	unsigned int bfirst;   /* linear index of first four-byte sequence */
+} grange_t;
+
+static const grange_t gb18030_ranges[] = {
+	{ 0x0452,  0x200F,      820 }, /* GB+8130D330 */
+	{ 0x2643,  0x2E80,     9219 }, /* GB+8137A839 */
+	{ 0x361B,  0x3917,    12973 }, /* GB+8230A633 */
+	{ 0x3CE1,  0x4055,    14698 }, /* GB+8231D438 */
+	{ 0x4160,  0x4336,    15847 }, /* GB+8232C937 */
+	{ 0x44D7,  0x464B,    16729 }, /* GB+8233A339 */
+	{ 0x478E,  0x4946,    17418 }, /* GB+8233E838 */
+	{ 0x49B8,  0x4C76,    17961 }, /* GB+8234A131 */
+	{ 0x9FA6,  0xD7FF,    19043 }, /* GB+82358F33 */
+	{ 0xE865,  0xF92B,    33550 }, /* GB+8336D030 */
+	{ 0xFA2A,  0xFE2F,    38078 }, /* GB+84309C38 */
+	{ 0xFFE6,  0xFFFF,    39394 }, /* GB+8431A234 */
+	{ 0x10000, 0x10FFFF, 189000 }, /* GB+90308130 */
+};
+
+static const int ngb18030_ranges = sizeof( gb18030_ranges ) / sizeof( gb18030_ranges[0] );
+
+/* Byte sequence -> Unicode indices for gb18030_enums[], built on first use
+ *
+ * Two-byte characters are indexed directly by {0x81-0xFE}{0x40-0xFE},
+ * 0 meaning none. The four-byte characters are kept in order of their
+ * linear index, which also follows Unicode order, for a binary search.
+ */
+#define GB18030_TWOBYTE( lead, trail ) ( ( (lead) - 0x81 ) * 191 + ( (trail) - 0x40 ) )
+
+typedef struct gfour_t {
+	unsigned int linear, unicode;
+} gfour_t;
+
+static unsigned short gb18030_twobyte[ 126 * 191 ];
+static gfour_t gb18030_fourbyte[ sizeof( gb18030_enums ) / sizeof( gb18030_enums[0] ) ];
+static int ngb18030_fourbyte = 0;
+static bu_once_t gb18030_index_once = BU_ONCE_INIT;
+
+static void
+gb18030_index_build( void )
+{
+	const genums_t *e;
+	unsigned int i;
+
+	for ( i=0; i<ngb18030_enums; ++i ) {
+		e = &(gb18030_enums[i]);
+		if ( e->len==2 )
+			gb18030_twobyte[ GB18030_TWOBYTE( e->bytes[0], e->bytes[1] ) ] = e->unicode;
+		else if ( e->len==4 ) {
+			gb18030_fourbyte[ngb18030_fourbyte].linear  = gb18030_linear( ( unsigned char * ) e->bytes );
+			gb18030_fourbyte[ngb18030_fourbyte].unicode = e->unicode;
+			ngb18030_fourbyte++;
+		}
+	}
+}
+
 /* Get GB 18030 from Unicode Value in Table */
 static int
 gb18030_unicode_table_lookup( unsigned int unicode, unsigned char out[4] )
 {
-	int i, j;
+	int min = 0, max = ngb18030_enums, mid, j;
 	if ( unicode >= 0x0080 && unicode <= 0xFFE5 ) {
-		/* list is sorted, so should do binary search here */
-		for ( i=0; i<ngb18030_enums; ++i ) {
-			if ( unicode == gb18030_enums[i].unicode ) {
-				for ( j=0; j<gb18030_enums[i].len; ++j )
-					out[j] = gb18030_enums[i].bytes[j];
-				return gb18030_enums[i].len;
-			}
+		/* list is sorted by unicode */
+		while ( min < max ) {
+			mid = ( min + max ) / 2;
+			if ( gb18030_enums[mid].unicode < unicode ) min = mid + 1;
+			else max = mid;
+		}
+		if ( min < ngb18030_enums && gb18030_enums[min].unicode == unicode ) {
+			for ( j=0; j<gb18030_enums[min].len; ++j )
+				out[j] = gb18030_enums[min].bytes[j];
+			return gb18030_enums[min].len;
 		}
 	}
 	return 0;
 }
 
-static int
-gb18030_match( unsigned char *s, const unsigned char *bytes, unsigned char len )
-{
-	int i;
-	for ( i=0; i<len; ++i )
-		if ( ( s[i])!=bytes[i] ) return 0;
-	return 1;
-}
-
 static unsigned int
 gb18030_table_lookup( unsigned char *uc, unsigned char len, int *found )
 {
-	unsigned int i;
+	unsigned int linear;
+	int min = 0, max, mid;
+
+	bu_once( &gb18030_index_once, gb18030_index_build );
+
 	*found = 0;
-	for ( i=0; i<ngb18030_enums; ++i ) {
-		if ( gb18030_enums[i].len!=len ) continue;
-		if ( gb18030_match( &(uc[0]), gb18030_enums[i].bytes, len ) ) {
+
+	if ( len==2 ) {
+		if ( gb18030_twobyte[ GB18030_TWOBYTE( uc[0], uc[1] ) ] ) {
+			*found = 1;
+			return gb18030_twobyte[ GB18030_TWOBYTE( uc[0], uc[1] ) ];
+		}
+	}
+
+	else if ( len==4 ) {
+		linear = gb18030_linear( uc );
+		max = ngb18030_fourbyte;
+		while ( min < max ) {
+			mid = ( min + max ) / 2;
+			if ( gb18030_fourbyte[mid].linear < linear ) min = mid + 1;
+			else max = mid;
+		}
+		if ( min < ngb18030_fourbyte && gb18030_fourbyte[min].linear == linear ) {
 			*found = 1;
-			return gb18030_enums[i].unicode;
+			return gb18030_fourbyte[min].unicode;
 		}
 	}
+
 	return '?';
 }
 
-
 static int
 gb18030_unicode_range_lookup( unsigned int unicode, unsigned char out[4] ) 
 {
+	int i;
+	for ( i=0; i<ngb18030_ranges; ++i ) {
+		if ( unicode < gb18030_ranges[i].ufirst ) break;
+		if ( unicode <= gb18030_ranges[i].ulast ) {
+			gb18030_fromlinear( gb18030_ranges[i].bfirst + ( unicode - gb18030_ranges[i].ufirst ), out );
+			return 4;
+		}
+	}
 	return 0;
 }
 
-static int
+static unsigned int
 gb18030_range_lookup( unsigned char *s, /* unsigned char len = 4 only */ int *found )
 {
+	unsigned int linear = gb18030_linear( s ), last;
+	int i;
 	*found = 0;
-	return 0;
-#if 0
-  <!-- Roundtrip-mappings that can be enumerated
-       Note that GB 18030 defines roundtrip mappings for all Unicode code points U+0000..U+10ffff.
-       This would require 1.1 million <a> elements.
-       However, most four-byte GB 18030 mappings can be enumerated efficiently within distinct ranges.
-       Therefore, we use <range> elements for all but the 31000 or so assignments above.
-    -->
-  <range uFirst="0452" uLast="200F"  bFirst="81 30 D3 30" bLast="81 36 A5 31"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="2643" uLast="2E80"  bFirst="81 37 A8 39" bLast="81 38 FD 38"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="361B" uLast="3917"  bFirst="82 30 A6 33" bLast="82 30 F2 37"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="3CE1" uLast="4055"  bFirst="82 31 D4 38" bLast="82 32 AF 32"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="4160" uLast="4336"  bFirst="82 32 C9 37" bLast="82 32 F8 37"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="44D7" uLast="464B"  bFirst="82 33 A3 39" bLast="82 33 C9 31"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="478E" uLast="4946"  bFirst="82 33 E8 38" bLast="82 34 96 38"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="49B8" uLast="4C76"  bFirst="82 34 A1 31" bLast="82 34 E7 33"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="9FA6" uLast="D7FF"  bFirst="82 35 8F 33" bLast="83 36 C7 38"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="E865" uLast="F92B"  bFirst="83 36 D0 30" bLast="84 30 85 34"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="FA2A" uLast="FE2F"  bFirst="84 30 9C 38" bLast="84 31 85 37"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="FFE6" uLast="FFFF"  bFirst="84 31 A2 34" bLast="84 31 A4 39"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-  <range uFirst="10000" uLast="10FFFF"  bFirst="90 30 81 30" bLast="E3 32 9A 35"  bMin="81 30 81 30" bMax="FE 39 FE 39"/>
-#endif
+	for ( i=0; i<ngb18030_ranges; ++i ) {
+		if ( linear < gb18030_ranges[i].bfirst ) break;
+		last = gb18030_ranges[i].bfirst + ( gb18030_ranges[i].ulast - gb18030_ranges[i].ufirst );
+		if ( linear <= last ) {
+			*found = 1;
+			return gb18030_ranges[i].ufirst + ( linear - gb18030_ranges[i].bfirst );
+		}
+	}
+	return '?';
 }
 
 unsigned int
@@ -122,7 +212,8 @@ gb18030_to_unicode( unsigned char *s, unsigned char len )
 /*
  * Convert unicode character to gb18030
  *
- * returns number of characters for output
+ * returns number of characters for output; characters that can't be
+ * encoded (surrogates, beyond U+10FFFF) become '?'
  */
 int
 gb18030_encode( unsigned int unicode, unsigned char out[4] )
@@ -135,6 +226,10 @@ gb18030_encode( unsigned int unicode, unsigned char out[4] )
 		len = gb18030_unicode_table_lookup( unicode, out );
 		if ( !len )
 			len = gb18030_unicode_range_lookup( unicode, out ); 
+		if ( !len ) {
+			out[0] = '?';
+			len = 1;
+		}
 	}
 	return len;
 }
@@ -30742,5 +30742,5 @@ genums_t gb18030_enums[] = {
 	{0xFFE5,2,{0xA3,0xA4,0x00,0x00,}},
 };
 
-unsigned int ngb18030_enums = sizeof( gb18030_enums ) / sizeof( gb18030_enums[0] );
+static const unsigned int ngb18030_enums = sizeof( gb18030_enums ) / sizeof( gb18030_enums[0] );
 
@@ -0,0 +1,265 @@
+/*
+ * inbuf.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Implements the input source for the readf functions
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+#include "inbuf.h"
+
+/* Initial size of the fgets() block; it doubles for longer lines */
+#define INBUF_BLOCKSIZE (65536)
+
+void
+inbuf_initmem( inbuf *in, const char *buf, size_t len )
+{
+	in->fp      = NULL;
+	in->data    = ( char * ) buf;
+	in->len     = len;
+	in->pos     = 0;
+	in->dim     = 0;
+	in->first   = 0;
+	in->dropped = 0;
+	in->mapped  = 0;
+	in->eof     = 1;
+	in->status  = INBUF_OK;
+}
+
+/* inbuf_map()
+ *
+ * Map the rest of a regular file, starting where fp is now. Returns 1
+ * on success, 0 if the input has to be read through fp instead.
+ */
+#ifdef WIN32
+static int
+inbuf_map( inbuf *in )
+{
+	return 0;
+}
+#else
+static int
+inbuf_map( inbuf *in )
+{
+	struct stat st;
+	long pos;
+	void *m;
+	int fd;
+
+	pos = ftell( in->fp );
+	if ( pos < 0 ) return 0;
+
+	fd = fileno( in->fp );
+	if ( fd < 0 || fstat( fd, &st ) || !S_ISREG( st.st_mode ) ) return 0;
+	if ( st.st_size <= pos ) return 0;
+	if ( ( off_t ) ( size_t ) st.st_size != st.st_size ) return 0;
+
+	m = mmap( NULL, ( size_t ) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	if ( m==MAP_FAILED ) return 0;
+#ifdef MADV_SEQUENTIAL
+	madvise( m, ( size_t ) st.st_size, MADV_SEQUENTIAL );
+#endif
+
+	in->data   = ( char * ) m;
+	in->len    = ( size_t ) st.st_size;
+	in->pos    = ( size_t ) pos;
+	in->first  = ( size_t ) pos;
+	in->mapped = 1;
+	return 1;
+}
+#endif
+
+/* inbuf_init()
+ *
+ * Returns INBUF_OK or INBUF_MEMERR
+ */
+int
+inbuf_init( inbuf *in, FILE *fp )
+{
+	inbuf_initmem( in, NULL, 0 );
+	in->fp = fp;
+
+	if ( inbuf_map( in ) ) return INBUF_OK;
+
+	in->data = ( char * ) malloc( INBUF_BLOCKSIZE );
+	if ( !in->data ) {
+		in->status = INBUF_MEMERR;
+		return INBUF_MEMERR;
+	}
+	in->data[0] = '\0';
+	in->dim = INBUF_BLOCKSIZE;
+	in->eof = 0;
+
+	return INBUF_OK;
+}
+
+/* inbuf_free()
+ *
+ * A mapped file's stream is left just past the input that was handed
+ * out, as if it had been read through fp.
+ */
+void
+inbuf_free( inbuf *in )
+{
+#ifndef WIN32
+	if ( in->mapped ) {
+		munmap( in->data, in->len );
+		fseek( in->fp, ( long ) in->pos, SEEK_SET );
+	}
+#endif
+	if ( in->dim ) free( in->data );
+	inbuf_initmem( in, NULL, 0 );
+}
+
+/* inbuf_fill()
+ *
+ * Read the next line (or as much of it as fits) from fp onto the end
+ * of the block, first moving the bytes not yet handed out to its
+ * start. Returns 0 at end of input or on memory error.
+ */
+static int
+inbuf_fill( inbuf *in )
+{
+	size_t room;
+	char *p;
+
+	if ( in->eof || in->status!=INBUF_OK ) return 0;
+
+	if ( in->pos ) {
+		memmove( in->data, in->data + in->pos, in->len - in->pos );
+		in->dropped += in->pos;
+		in->len     -= in->pos;
+		in->pos      = 0;
+	}
+
+	if ( in->dim - in->len < INBUF_BLOCKSIZE / 4 ) {
+		p = ( char * ) realloc( in->data, in->dim * 2 );
+		if ( !p ) {
+			in->status = INBUF_MEMERR;
+			return 0;
+		}
+		in->data = p;
+		in->dim *= 2;
+	}
+
+	room = in->dim - in->len;
+	if ( room > INT_MAX ) room = INT_MAX;
+
+	if ( !fgets( in->data + in->len, ( int ) room, in->fp ) ) {
+		in->eof = 1;
+		return 0;
+	}
+	in->len += strlen( in->data + in->len );
+
+	return 1;
+}
+
+/* inbuf_eol()
+ *
+ * Returns the offset of the first '\n' (or, unless raw, '\r') at or
+ * after pos, reading more input as needed, or len if the input ends
+ * first. A '\r' is only returned once it's known whether a '\n'
+ * follows it.
+ */
+static size_t
+inbuf_eol( inbuf *in, int raw )
+{
+	const char *s, *nl, *cr;
+	size_t from = 0, n;
+
+	while ( 1 ) {
+		s  = in->data + in->pos + from;
+		n  = in->len - in->pos - from;
+		nl = n ? memchr( s, '\n', n ) : NULL;
+		cr = ( raw || !n ) ? NULL : memchr( s, '\r', nl ? ( size_t ) ( nl - s ) : n );
+
+		if ( cr && ( ( size_t ) ( cr - in->data ) + 1 < in->len || in->eof ) )
+			return cr - in->data;
+		if ( !cr && nl ) return nl - in->data;
+
+		/* inbuf_fill() moves the data, so keep the offset from pos */
+		from = ( cr ? cr : s + n ) - ( in->data + in->pos );
+		if ( !inbuf_fill( in ) )
+			return cr ? in->pos + from : in->len;
+	}
+}
+
+/* inbuf_getline()
+ *
+ * Returns 1 and the next line in *line and *n, or 0 at end of input.
+ */
+int
+inbuf_getline( inbuf *in, const char **line, size_t *n )
+{
+	size_t eol;
+
+	eol = inbuf_eol( in, 0 );
+	if ( in->pos==in->len ) return 0;
+
+	*line = in->data + in->pos;
+	*n    = eol - in->pos;
+
+	if ( eol < in->len ) {
+		if ( in->data[eol]=='\r' && eol+1 < in->len && in->data[eol+1]=='\n' ) eol++;
+		eol++;
+	}
+	in->pos = eol;
+
+	return 1;
+}
+
+/* inbuf_getraw()
+ *
+ * Returns 1 and the bytes up to and including the next '\n' in
+ * *line and *n, or 0 at end of input.
+ */
+int
+inbuf_getraw( inbuf *in, const char **line, size_t *n )
+{
+	size_t eol;
+
+	eol = inbuf_eol( in, 1 );
+	if ( in->pos==in->len ) return 0;
+
+	if ( eol < in->len ) eol++;
+
+	*line = in->data + in->pos;
+	*n    = eol - in->pos;
+	in->pos = eol;
+
+	return 1;
+}
+
+int
+inbuf_getstr( inbuf *in, str *line )
+{
+	const char *p;
+	size_t n;
+
+	str_empty( line );
+
+	if ( !inbuf_getline( in, &p, &n ) ) return 0;
+	if ( n ) str_segcat( line, ( char * ) p, ( char * ) p + n );
+
+	return 1;
+}
+
+/* inbuf_nread()
+ *
+ * Returns the number of bytes handed out so far.
+ */
+size_t
+inbuf_nread( inbuf *in )
+{
+	return in->dropped + in->pos - in->first;
+}
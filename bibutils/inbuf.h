@@ -0,0 +1,61 @@
+/*
+ * inbuf.h
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef INBUF_H
+#define INBUF_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "str.h"
+
+#define INBUF_OK     (0)
+#define INBUF_MEMERR (-1)
+
+/* inbuf
+ *
+ * The input handed to the readbuf functions. A regular file is mapped
+ * into memory and a memory buffer is used as it is, so lines are
+ * sliced straight out of the input. Anything else (pipes, the standard
+ * input, or where mmap() isn't available) is read through fp with
+ * fgets() into a growing block, so input is still consumed a line at
+ * a time.
+ *
+ * inbuf_getline() hands out the next line without its line end ("\n",
+ * "\r\n" or "\r") and inbuf_getraw() the next run of bytes up to and
+ * including a '\n', as fgets() would. Either way the slice is not
+ * '\0'-terminated and only stays valid until the next call on the
+ * inbuf. inbuf_getstr() copies the next line into a str instead.
+ *
+ * "\n\r" is two line ends with an empty line between them. That is
+ * what str_fget() gave as well: it only joined the two when both were
+ * in its buffer, and fgets() always stops after the '\n'.
+ */
+typedef struct inbuf {
+	FILE   *fp;       /* NULL for memory buffers */
+	char   *data;
+	size_t  len;      /* bytes of input in data */
+	size_t  pos;      /* next byte to hand out */
+	size_t  dim;      /* size of the fgets() block, 0 if not ours */
+	size_t  first;    /* pos when the inbuf was set up */
+	size_t  dropped;  /* bytes moved out of the fgets() block */
+	int     mapped;
+	int     eof;
+	int     status;
+} inbuf;
+
+int    inbuf_init   ( inbuf *in, FILE *fp );
+void   inbuf_initmem( inbuf *in, const char *buf, size_t len );
+void   inbuf_free   ( inbuf *in );
+
+int    inbuf_getline( inbuf *in, const char **line, size_t *n );
+int    inbuf_getraw ( inbuf *in, const char **line, size_t *n );
+int    inbuf_getstr ( inbuf *in, str *line );
+
+size_t inbuf_nread  ( inbuf *in );
+
+#endif
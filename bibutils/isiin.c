@@ -22,7 +22,7 @@
 extern variants isi_all[];
 extern int isi_nall;
 
-static int isiin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int isiin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int isiin_typef( fields *isiin, const char *filename, int nref, param *p );
 static int isiin_convertf( fields *isiin, fields *info, int reftype, param *p );
 static int isiin_processf( fields *isiin, const char *p, const char *filename, long nref, param *pm );
@@ -45,7 +45,8 @@ isiin_initparams( param *pm, const char *progname )
 	pm->addcount         = 0;
 	pm->output_raw       = 0;
 
-	pm->readf    = isiin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = isiin_readf;
 	pm->processf = isiin_processf;
 	pm->cleanf   = NULL;
 	pm->typef    = isiin_typef;
@@ -83,21 +84,21 @@ is_isi_tag( const char *buf )
 }
 
 static int
-readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
+readmore( inbuf *in, str *line )
 {
 	if ( line->len ) return 1;
-	else return str_fget( fp, buf, bufsize, bufpos, line );
+	else return inbuf_getstr( in, line );
 }
 
 static int
-isiin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+isiin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	int haveref = 0, inref = 0;
 	char *p;
 
 	*fcharset = CHARSET_UNKNOWN;
 
-	while ( !haveref && readmore( fp, buf, bufsize, bufpos, line ) ) {
+	while ( !haveref && readmore( in, line ) ) {
 
 		if ( str_is_empty( line ) ) continue;
 
@@ -2,6 +2,8 @@
  * iso639_1.c
  */
 #include <string.h>
+#include "bu_thread.h"
+#include "strhash.h"
 #include "iso639_1.h"
 
 typedef struct {
@@ -198,10 +200,40 @@ static iso639_1_t iso639_1[] = {
 };
 static int niso639_1= sizeof( iso639_1 ) / sizeof( iso639_1[0] );
 
+static strhash iso639_1_codes;
+static int iso639_1_hashed = 0;
+static bu_once_t iso639_1_once = BU_ONCE_INIT;
+
+static void
+iso639_1_build( void )
+{
+	int i;
+
+	strhash_init( &iso639_1_codes, STRHASH_NOCASE );
+
+	for ( i=0; i<niso639_1; ++i ) {
+		if ( strhash_add( &iso639_1_codes, iso639_1[i].code, i )!=STRHASH_OK ) {
+			strhash_free( &iso639_1_codes );
+			return;
+		}
+	}
+
+	iso639_1_hashed = 1;
+}
+
 char *
 iso639_1_from_code( const char *code )
 {
+	long n;
 	int i;
+
+	bu_once( &iso639_1_once, iso639_1_build );
+	if ( iso639_1_hashed ) {
+		n = strhash_find( &iso639_1_codes, code );
+		if ( n==STRHASH_NOTFOUND ) return NULL;
+		return iso639_1[n].language;
+	}
+
 	for ( i=0; i<niso639_1; ++i ) {
 		if ( !strcasecmp( iso639_1[i].code, code ) )
 			return iso639_1[i].language;
@@ -2,6 +2,8 @@
  * iso639-2 language codes
  */
 #include <string.h>
+#include "bu_thread.h"
+#include "strhash.h"
 #include "iso639_2.h"
 
 typedef struct {
@@ -586,10 +588,64 @@ static iso639_2_t iso639_2[] = {
 };
 static int niso639_2= sizeof( iso639_2 ) / sizeof( iso639_2[0] );
 
+/* hashes of iso639_2[] by code and by language, built once and then
+ * only read
+ *
+ * The linear iso639_2_from_language() stops at the first language
+ * sorting after the one asked for, so an entry out of alphabetical
+ * order can be unreachable; only index entries it could have found.
+ */
+static strhash iso639_2_codes;
+static strhash iso639_2_languages;
+static int iso639_2_hashed = 0;
+static bu_once_t iso639_2_once = BU_ONCE_INIT;
+
+static void
+iso639_2_build( void )
+{
+	char *last = NULL;
+	int i, ok = 1;
+
+	strhash_init( &iso639_2_codes, STRHASH_NOCASE );
+	strhash_init( &iso639_2_languages, STRHASH_NOCASE );
+
+	for ( i=0; i<niso639_2 && ok; ++i ) {
+		if ( iso639_2[i].main ) {
+			if ( strhash_add( &iso639_2_codes, iso639_2[i].code1, i )!=STRHASH_OK )
+				ok = 0;
+			if ( iso639_2[i].code2[0]!='\0' &&
+			     strhash_add( &iso639_2_codes, iso639_2[i].code2, i )!=STRHASH_OK )
+				ok = 0;
+		}
+		if ( !last || strcasecmp( last, iso639_2[i].language ) <= 0 ) {
+			if ( strhash_add( &iso639_2_languages, iso639_2[i].language, i )!=STRHASH_OK )
+				ok = 0;
+			last = iso639_2[i].language;
+		}
+	}
+
+	if ( !ok ) {
+		strhash_free( &iso639_2_codes );
+		strhash_free( &iso639_2_languages );
+		return;
+	}
+
+	iso639_2_hashed = 1;
+}
+
 char *
 iso639_2_from_code( char *code )
 {
+	long n;
 	int i;
+
+	bu_once( &iso639_2_once, iso639_2_build );
+	if ( iso639_2_hashed ) {
+		n = strhash_find( &iso639_2_codes, code );
+		if ( n==STRHASH_NOTFOUND ) return NULL;
+		return iso639_2[n].language;
+	}
+
 	for ( i=0; i<niso639_2; ++i ) {
 		if ( !iso639_2[i].main ) continue;
 		if ( !strcasecmp( iso639_2[i].code1, code ) )
@@ -603,7 +659,16 @@ iso639_2_from_code( char *code )
 char *
 iso639_2_from_language( char *lang )
 {
+	long m;
 	int i, n;
+
+	bu_once( &iso639_2_once, iso639_2_build );
+	if ( iso639_2_hashed ) {
+		m = strhash_find( &iso639_2_languages, lang );
+		if ( m==STRHASH_NOTFOUND ) return NULL;
+		return iso639_2[m].code1;
+	}
+
 	for ( i=0; i<niso639_2; ++i ) {
 		n = strcasecmp( iso639_2[i].language, lang );
 		if ( n==0 ) return iso639_2[i].code1;
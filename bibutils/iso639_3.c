@@ -2,6 +2,8 @@
  * iso639_3.c
  */
 #include <string.h>
+#include "bu_thread.h"
+#include "strhash.h"
 #include "iso639_3.h"
 
 typedef struct {
@@ -8407,10 +8409,48 @@ static iso639_3_t iso639_3[] = {
 };
 static int niso639_3= sizeof( iso639_3 ) / sizeof( iso639_3[0] );
 
+/* hashes of iso639_3[] by code and by name, built once and then only
+ * read; strhash_add() keeps the first entry for a repeated key, as the
+ * linear scans did
+ */
+static strhash iso639_3_codes;
+static strhash iso639_3_names;
+static int iso639_3_hashed = 0;
+static bu_once_t iso639_3_once = BU_ONCE_INIT;
+
+static void
+iso639_3_build( void )
+{
+	int i;
+
+	strhash_init( &iso639_3_codes, STRHASH_NOCASE );
+	strhash_init( &iso639_3_names, STRHASH_NOCASE );
+
+	for ( i=0; i<niso639_3; ++i ) {
+		if ( strhash_add( &iso639_3_codes, iso639_3[i].code, i )!=STRHASH_OK ||
+		     strhash_add( &iso639_3_names, iso639_3[i].language, i )!=STRHASH_OK ) {
+			strhash_free( &iso639_3_codes );
+			strhash_free( &iso639_3_names );
+			return;
+		}
+	}
+
+	iso639_3_hashed = 1;
+}
+
 char *
 iso639_3_from_code( const char *code )
 {
+	long n;
 	int i;
+
+	bu_once( &iso639_3_once, iso639_3_build );
+	if ( iso639_3_hashed ) {
+		n = strhash_find( &iso639_3_codes, code );
+		if ( n==STRHASH_NOTFOUND ) return NULL;
+		return iso639_3[n].language;
+	}
+
 	for ( i=0; i<niso639_3; ++i ) {
 		if ( !strcasecmp( iso639_3[i].code, code ) )
 			return iso639_3[i].language;
@@ -8421,7 +8461,16 @@ iso639_3_from_code( const char *code )
 char *
 iso639_3_from_name( const char *name )
 {
+	long n;
 	int i;
+
+	bu_once( &iso639_3_once, iso639_3_build );
+	if ( iso639_3_hashed ) {
+		n = strhash_find( &iso639_3_names, name );
+		if ( n==STRHASH_NOTFOUND ) return NULL;
+		return iso639_3[n].code;
+	}
+
 	for ( i=0; i<niso639_3; ++i ) {
 		if ( !strcasecmp( iso639_3[i].language, name ) )
 			return iso639_3[i].code;
@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "bu_thread.h"
 #include "latex.h"
 
 #define LATEX_COMBO (0)  /* 'combo' no need for protection on output */
@@ -465,6 +466,145 @@ static struct latex_chars only_from_latex[] = {
 static int num_only_from_latex = sizeof( only_from_latex ) / sizeof( only_from_latex[0] );
 
 
+/* LaTeX input trie
+ *
+ * The input variants of a table are compiled into a trie on first use,
+ * so that every variant matching the start of p can be found in a single
+ * pass over p. Each node remembers the earliest table position (entry *
+ * NUM_VARIANTS + variant) ending there, and as with a scan of the table
+ * the earliest matching variant wins, not the longest one.
+ *
+ * Edges live in an open-addressing hash keyed on (node, character).
+ */
+typedef struct latex_edge {
+	int from, to;           /* from==-1 marks an empty slot */
+	unsigned char ch;
+} latex_edge;
+
+typedef struct latex_trie {
+	int *first;             /* per node: earliest table position ending here, or -1 */
+	int nnodes, maxnodes;
+	latex_edge *edges;
+	unsigned long nedges_mask;
+} latex_trie;
+
+static latex_trie latex_chars_trie, only_from_latex_trie;
+static int latex_tries_ok = 0;
+static bu_once_t latex_tries_once = BU_ONCE_INIT;
+
+static unsigned long
+latex_trie_slot( latex_trie *t, int from, unsigned char ch )
+{
+	unsigned long pos = ( ( unsigned long ) from * 31 + ch ) & t->nedges_mask;
+
+	while ( t->edges[pos].from!=-1 && ( t->edges[pos].from!=from || t->edges[pos].ch!=ch ) )
+		pos = ( pos + 1 ) & t->nedges_mask;
+
+	return pos;
+}
+
+static int
+latex_trie_child( latex_trie *t, int from, unsigned char ch )
+{
+	unsigned long pos = latex_trie_slot( t, from, ch );
+
+	if ( t->edges[pos].from==-1 ) return -1;
+	return t->edges[pos].to;
+}
+
+static void
+latex_trie_free( latex_trie *t )
+{
+	if ( t->first ) free( t->first );
+	if ( t->edges ) free( t->edges );
+	t->first = NULL;
+	t->edges = NULL;
+}
+
+static int
+latex_trie_build( latex_trie *t, struct latex_chars *lc, int n )
+{
+	struct latex_entry *variant;
+	unsigned long pos, size = 1;
+	int i, j, k, node, total = 1;
+
+	for ( i=0; i<n; ++i )
+		for ( j=0; j<NUM_VARIANTS && lc[i].variant[j].entry; ++j )
+			total += lc[i].variant[j].length;
+
+	/* one edge per node other than the root, hash at most half full */
+	while ( size < 2 * ( unsigned long ) total ) size *= 2;
+
+	t->nnodes      = 1;
+	t->maxnodes    = total;
+	t->nedges_mask = size - 1;
+	t->first       = ( int * ) malloc( sizeof( int ) * total );
+	t->edges       = ( latex_edge * ) malloc( sizeof( latex_edge ) * size );
+	if ( !t->first || !t->edges ) {
+		latex_trie_free( t );
+		return 0;
+	}
+
+	t->first[0] = -1;
+	for ( pos=0; pos<size; ++pos ) t->edges[pos].from = -1;
+
+	for ( i=0; i<n; ++i ) {
+		for ( j=0; j<NUM_VARIANTS; ++j ) {
+			variant = &( lc[i].variant[j] );
+			if ( variant->entry == NULL ) break;
+			node = 0;
+			for ( k=0; k<variant->length; ++k ) {
+				pos = latex_trie_slot( t, node, ( unsigned char ) variant->entry[k] );
+				if ( t->edges[pos].from==-1 ) {
+					t->edges[pos].from = node;
+					t->edges[pos].ch   = ( unsigned char ) variant->entry[k];
+					t->edges[pos].to   = t->nnodes;
+					t->first[ t->nnodes ] = -1;
+					t->nnodes++;
+				}
+				node = t->edges[pos].to;
+			}
+			if ( t->first[node]==-1 ) t->first[node] = i * NUM_VARIANTS + j;
+		}
+	}
+
+	return 1;
+}
+
+static void
+latex_tries_build( void )
+{
+	if ( !latex_trie_build( &latex_chars_trie, latex_chars, nlatex_chars ) ) return;
+	if ( !latex_trie_build( &only_from_latex_trie, only_from_latex, num_only_from_latex ) ) {
+		latex_trie_free( &latex_chars_trie );
+		return;
+	}
+	latex_tries_ok = 1;
+}
+
+/* lookup_latex_trie()
+ *
+ * Returns the index into lc of the earliest variant matching the start
+ * of p, storing its length in *len, or -1.
+ */
+static int
+lookup_latex_trie( latex_trie *t, char *p, int *len )
+{
+	int k, node = 0, best = -1;
+
+	for ( k=0; p[k]; ++k ) {
+		node = latex_trie_child( t, node, ( unsigned char ) p[k] );
+		if ( node==-1 ) break;
+		if ( t->first[node]!=-1 && ( best==-1 || t->first[node] < best ) ) {
+			best = t->first[node];
+			*len = k + 1;
+		}
+	}
+
+	if ( best==-1 ) return -1;
+	return best / NUM_VARIANTS;
+}
+
 /* latex2char()
  *
  *   Use the latex_chars[] lookup table to determine if any character
@@ -476,11 +616,22 @@ static int num_only_from_latex = sizeof( only_from_latex ) / sizeof( only_from_l
  *
  */
 static unsigned int
-lookup_latex( struct latex_chars *lc, int n, char *p, unsigned int *pos, int *unicode )
+lookup_latex( struct latex_chars *lc, int n, latex_trie *t, char *p, unsigned int *pos, int *unicode )
 {
 	struct latex_entry *variant;
-	int i, j;
+	int i, j, len;
+
+	bu_once( &latex_tries_once, latex_tries_build );
+
+	if ( latex_tries_ok ) {
+		i = lookup_latex_trie( t, p, &len );
+		if ( i==-1 ) return 0;
+		*pos = *pos + len;
+		*unicode = 1;
+		return lc[i].unicode;
+	}
 
+	/* couldn't build the tries, scan the table */
 	for ( i=0; i<n; ++i ) {
 		for ( j=0; j<NUM_VARIANTS; ++j ) {
 			variant = &(lc[i].variant[j] );
@@ -506,12 +657,12 @@ latex2char( char *s, unsigned int *pos, int *unicode )
 	value = (unsigned char) *p;
 
 	if ( strchr( "\\\'\"`-^_lL", value ) ) {
-		result = lookup_latex( latex_chars, nlatex_chars, p, pos, unicode );
+		result = lookup_latex( latex_chars, nlatex_chars, &latex_chars_trie, p, pos, unicode );
 		if ( result!=0 ) return result;
 	}
 
 	if ( value=='~' || value=='\\' ) {
-		result = lookup_latex( only_from_latex, num_only_from_latex, p, pos, unicode );
+		result = lookup_latex( only_from_latex, num_only_from_latex, &only_from_latex_trie, p, pos, unicode );
 		if ( result!=0 ) return result;
 	}
 
@@ -520,51 +671,183 @@ latex2char( char *s, unsigned int *pos, int *unicode )
 	return value;
 }
 
-void
-uni2latex( unsigned int ch, char buf[], int buf_size )
+/* latex2char_plain()
+ *
+ * Returns 1 if latex2char() passes the ASCII byte c through unchanged,
+ * one byte at a time, whatever follows it.
+ */
+int
+latex2char_plain( unsigned char c )
 {
-	int i, j, n;
+	if ( c=='\0' || c > 127 ) return 0;
 
-	if ( buf_size==0 ) return;
+	bu_once( &latex_tries_once, latex_tries_build );
 
-	buf[0] = '?';
-	buf[1] = '\0';
+	if ( !latex_tries_ok ) return !strchr( "\\\'\"`-^_lL~", c );
 
-	if ( ch==' ' ) {
-		buf[0] = ' '; /*special case to avoid &nbsp;*/
-		return;
+	if ( strchr( "\\\'\"`-^_lL", c ) && latex_trie_child( &latex_chars_trie, 0, c )!=-1 )
+		return 0;
+	if ( ( c=='~' || c=='\\' ) && latex_trie_child( &only_from_latex_trie, 0, c )!=-1 )
+		return 0;
+
+	return 1;
+}
+
+/* LaTeX output index
+ *
+ * For each code point in latex_chars[] (the first entry wins), the output
+ * rendered once with its {\macro} or $math$ protection, sorted by code
+ * point. Built on first use.
+ */
+#define LATEX_OUTLEN (64)
+
+typedef struct latex_out {
+	unsigned int unicode;
+	int pos;                /* position in latex_chars[] */
+	int len;
+	char out[LATEX_OUTLEN];
+} latex_out;
+
+static latex_out latex_outs[ sizeof( latex_chars ) / sizeof( latex_chars[0] ) ];
+static int nlatex_outs = 0;
+static bu_once_t latex_outs_once = BU_ONCE_INIT;
+
+static int
+latex_out_comp( const void *v1, const void *v2 )
+{
+	const latex_out *o1 = ( const latex_out * ) v1;
+	const latex_out *o2 = ( const latex_out * ) v2;
+
+	if ( o1->unicode < o2->unicode ) return -1;
+	if ( o1->unicode > o2->unicode ) return 1;
+	return o1->pos - o2->pos;
+}
+
+/* latex_render()
+ *
+ * Write the protected output of lc to buf (truncated to fit buf_size)
+ * and return its length.
+ */
+static int
+latex_render( struct latex_chars *lc, char buf[], int buf_size )
+{
+	int n = 0, j;
+
+	if ( lc->type == LATEX_MACRO ) {
+		if ( n < buf_size ) buf[n++] = '{';
+		if ( n < buf_size ) buf[n++] = '\\';
+	}
+	else if ( lc->type == LATEX_MATH ) {
+		if ( n < buf_size ) buf[n++] = '$';
+	}
+
+	j = 0;
+	while ( lc->out[j] ) {
+		if ( n < buf_size ) buf[n++] = lc->out[j];
+		j++;
+	}
+
+	if ( lc->type == LATEX_MACRO ) {
+		if ( n < buf_size ) buf[n++] = '}';
+	}
+	else if ( lc->type == LATEX_MATH ) {
+		if ( n < buf_size ) buf[n++] = '$';
 	}
 
+	if ( n >= buf_size ) n = buf_size - 1;
+	buf[n] = '\0';
+
+	return n;
+}
+
+static void
+latex_outs_build( void )
+{
+	int i, n;
+
 	for ( i=0; i<nlatex_chars; ++i ) {
-		if ( ch == latex_chars[i].unicode ) {
-			n = 0;
+		latex_outs[i].unicode = latex_chars[i].unicode;
+		latex_outs[i].pos     = i;
+	}
+	qsort( latex_outs, nlatex_chars, sizeof( latex_out ), latex_out_comp );
+
+	for ( i=0, n=0; i<nlatex_chars; ++i ) {
+		if ( n && latex_outs[n-1].unicode==latex_outs[i].unicode ) continue;
+		latex_outs[n].unicode = latex_outs[i].unicode;
+		latex_outs[n].pos     = latex_outs[i].pos;
+		latex_outs[n].len     = latex_render( &(latex_chars[ latex_outs[i].pos ]), latex_outs[n].out, LATEX_OUTLEN );
+		n++;
+	}
 
-			if ( latex_chars[i].type == LATEX_MACRO ) {
-				if ( n < buf_size ) buf[n++] = '{';
-				if ( n < buf_size ) buf[n++] = '\\';
-			}
-			else if ( latex_chars[i].type == LATEX_MATH ) {
-				if ( n < buf_size ) buf[n++] = '$';
-			}
+	nlatex_outs = n;
+}
 
-			j = 0;
-			while ( latex_chars[i].out[j] ) {
-				if ( n < buf_size ) buf[n++] = latex_chars[i].out[j];
-				j++;
-			}
+/* uni2latex_lookup()
+ *
+ * Returns the LaTeX output for ch, with its {\macro} or $math$ protection,
+ * setting *len to its length; NULL if ch has no LaTeX equivalent.
+ */
+const char *
+uni2latex_lookup( unsigned int ch, int *len )
+{
+	int min = 0, max, mid;
 
-			if ( latex_chars[i].type == LATEX_MACRO ) {
-				if ( n < buf_size ) buf[n++] = '}';
-			}
-			else if ( latex_chars[i].type == LATEX_MATH ) {
-				if ( n < buf_size ) buf[n++] = '$';
-			}
+	if ( ch==' ' ) {
+		*len = 1;
+		return " "; /*special case to avoid &nbsp;*/
+	}
 
-			if ( n < buf_size ) buf[n] = '\0';
-			else buf[ buf_size-1 ] = '\0';
+	bu_once( &latex_outs_once, latex_outs_build );
 
-			return;
-		}
+	max = nlatex_outs;
+	while ( min < max ) {
+		mid = ( min + max ) / 2;
+		if ( latex_outs[mid].unicode < ch ) min = mid + 1;
+		else max = mid;
+	}
+	if ( min < nlatex_outs && latex_outs[min].unicode==ch ) {
+		*len = latex_outs[min].len;
+		return latex_outs[min].out;
+	}
+
+	return NULL;
+}
+
+/* uni2latex_plain()
+ *
+ * Returns 1 if the LaTeX output for the ASCII character ch is ch itself.
+ */
+int
+uni2latex_plain( unsigned int ch )
+{
+	const char *out;
+	int len;
+
+	if ( ch=='\0' || ch > 127 ) return 0;
+
+	out = uni2latex_lookup( ch, &len );
+	if ( !out ) return 1;
+
+	return ( len==1 && ( unsigned char ) out[0]==ch );
+}
+
+void
+uni2latex( unsigned int ch, char buf[], int buf_size )
+{
+	const char *out;
+	int len;
+
+	if ( buf_size==0 ) return;
+
+	buf[0] = '?';
+	buf[1] = '\0';
+
+	out = uni2latex_lookup( ch, &len );
+	if ( out ) {
+		if ( len > buf_size - 1 ) len = buf_size - 1;
+		memcpy( buf, out, len );
+		buf[len] = '\0';
+		return;
 	}
 
 	if ( ch < 128 ) buf[0] = (char)ch;
@@ -11,6 +11,9 @@
 
 extern unsigned int latex2char( char *s, unsigned int *pos, int *unicode );
 extern void uni2latex( unsigned int ch, char buf[], int buf_size );
+extern const char *uni2latex_lookup( unsigned int ch, int *len );
+extern int latex2char_plain( unsigned char c );
+extern int uni2latex_plain( unsigned int ch );
 
 
 #endif
@@ -18,7 +18,7 @@
 #include "bibutils.h"
 #include "bibformats.h"
 
-static int medin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int medin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int medin_processf( fields *medin, const char *data, const char *filename, long nref, param *p );
 
 
@@ -40,7 +40,8 @@ medin_initparams( param *pm, const char *progname )
 	pm->output_raw       = BIBL_RAW_WITHMAKEREFID |
 	                      BIBL_RAW_WITHCHARCONVERT;
 
-	pm->readf    = medin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = medin_readf;
 	pm->processf = medin_processf;
 	pm->cleanf   = NULL;
 	pm->typef    = NULL;
@@ -92,13 +93,13 @@ medin_findendwrapper( char *buf, int ntype )
 }
 
 static int
-medin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+medin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	str tmp;
 	char *startptr = NULL, *endptr;
 	int haveref = 0, inref = 0, file_charset = CHARSET_UNKNOWN, m, type = -1;
 	str_init( &tmp );
-	while ( !haveref && str_fget( fp, buf, bufsize, bufpos, line ) ) {
+	while ( !haveref && inbuf_getstr( in, line ) ) {
 		if ( line->data ) {
 			m = xml_getencoding( line );
 			if ( m!=CHARSET_UNKNOWN ) file_charset = m;
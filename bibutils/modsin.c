@@ -28,7 +28,7 @@
 #include "bibutils.h"
 #include "bibformats.h"
 
-static int modsin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int modsin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int modsin_processf( fields *medin, const char *data, const char *filename, long nref, param *p );
 
 /*****************************************************
@@ -52,7 +52,8 @@ modsin_initparams( param *pm, const char *progname )
 	pm->output_raw       = BIBL_RAW_WITHMAKEREFID |
 	                      BIBL_RAW_WITHCHARCONVERT;
 
-	pm->readf    = modsin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = modsin_readf;
 	pm->processf = modsin_processf;
 	pm->cleanf   = NULL;
 	pm->typef    = NULL;
@@ -1131,7 +1132,7 @@ modsin_endptr( char *p )
 }
 
 static int
-modsin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+modsin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	str tmp;
 	int m, file_charset = CHARSET_UNKNOWN;
@@ -1152,7 +1153,7 @@ modsin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *ref
 			str_segcpy( reference, startptr, endptr );
 			str_strcpyc( line, endptr );
 		}
-	} while ( !endptr && str_fget( fp, buf, bufsize, bufpos, line ) );
+	} while ( !endptr && inbuf_getstr( in, line ) );
 
 	str_free( &tmp );
 	*fcharset = file_charset;
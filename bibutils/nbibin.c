@@ -29,7 +29,7 @@ extern int nbib_nall;
  PUBLIC: void nbib_initparams()
 *****************************************************/
 
-static int nbib_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int nbib_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int nbib_processf( fields *nbib, const char *p, const char *filename, long nref, param *pm );
 static int nbib_typef( fields *nbib, const char *filename, int nref, param *p );
 static int nbib_convertf( fields *nbib, fields *info, int reftype, param *p );
@@ -48,7 +48,8 @@ nbibin_initparams( param *pm, const char *progname )
 	pm->addcount         = 0;
 	pm->output_raw       = 0;
 
-	pm->readf    = nbib_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = nbib_readf;
 	pm->processf = nbib_processf;
 	pm->cleanf   = NULL;
 	pm->typef    = nbib_typef;
@@ -108,10 +109,10 @@ nbib_istag( const char *buf )
 }
 
 static int
-readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
+readmore( inbuf *in, str *line )
 {
 	if ( line->len ) return 1;
-	else return str_fget( fp, buf, bufsize, bufpos, line );
+	else return inbuf_getstr( in, line );
 }
 
 static int
@@ -131,14 +132,14 @@ skip_utf8_bom( str *line, int *fcharset )
 }
 
 static int
-nbib_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+nbib_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	int n, haveref = 0, inref = 0, readtoofar = 0;
 	char *p;
 
 	*fcharset = CHARSET_UNKNOWN;
 
-	while ( !haveref && readmore( fp, buf, bufsize, bufpos, line ) ) {
+	while ( !haveref && readmore( in, line ) ) {
 
 		/* ...references are terminated by an empty line */
 		if ( str_is_empty( line ) ) {
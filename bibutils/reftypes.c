@@ -7,25 +7,205 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include "bu_thread.h"
 #include "is_ws.h"
 #include "fields.h"
 #include "reftypes.h"
 
-int
-get_reftype( const char *p, long refnum, char *progname, variants *all, int nall, char *tag, int *is_default, int chattiness )
+static bu_mutex_t reftypes_index_lock = BU_MUTEX_INIT;
+
+/* reftypes_index_adds()
+ *
+ * Split the "TAG|value" newstr of each ALWAYS and DEFAULT lookup once,
+ * into one block holding both lists and the strings they point to.
+ */
+static int
+reftypes_index_adds( variants *v )
+{
+	reftypes_add *adds, *a;
+	unsigned long size = 0;
+	int i, process, n = 0;
+	char *buf, *p, *bar;
+
+	v->nalways = v->ndefaults = 0;
+
+	for ( i=0; i<v->ntags; ++i ) {
+		process = v->tags[i].processingtype;
+		if ( process!=ALWAYS && process!=DEFAULT ) continue;
+		if ( process==ALWAYS ) v->nalways++;
+		else v->ndefaults++;
+		if ( v->tags[i].newstr ) size += strlen( v->tags[i].newstr );
+		size += 2;
+		n++;
+	}
+
+	v->always = v->defaults = NULL;
+	if ( n==0 ) return 1;
+
+	adds = ( reftypes_add * ) malloc( sizeof( reftypes_add ) * n + size );
+	if ( !adds ) return 0;
+
+	buf = ( char * ) ( adds + n );
+	v->always   = adds;
+	v->defaults = adds + v->nalways;
+	v->nalways = v->ndefaults = 0;
+
+	for ( i=0; i<v->ntags; ++i ) {
+		process = v->tags[i].processingtype;
+		if ( process==ALWAYS ) a = &(v->always[ v->nalways++ ]);
+		else if ( process==DEFAULT ) a = &(v->defaults[ v->ndefaults++ ]);
+		else continue;
+
+		p = v->tags[i].newstr ? v->tags[i].newstr : "";
+		strcpy( buf, p );
+		a->tag   = buf;
+		a->level = v->tags[i].level;
+		bar = strchr( buf, '|' );
+		if ( bar ) {
+			*bar = '\0';
+			a->value = bar + 1;
+		} else {
+			a->value = buf + strlen( buf );
+		}
+		buf += strlen( p ) + 2;
+	}
+
+	return 1;
+}
+
+static int
+reftypes_index_variant( variants *v )
 {
 	int i;
 
-	p = skip_ws( p );
+	if ( !reftypes_index_adds( v ) ) return 0;
 
-	*is_default = 0;
+	strhash_init( &(v->tagindex), STRHASH_NOCASE );
+
+	/* strhash_add() keeps the first position of a repeated oldstr */
+	for ( i=0; i<v->ntags; ++i ) {
+		if ( strhash_add( &(v->tagindex), v->tags[i].oldstr, i )!=STRHASH_OK ) {
+			strhash_free( &(v->tagindex) );
+			if ( v->always ) free( v->always );
+			v->always = v->defaults = NULL;
+			v->nalways = v->ndefaults = 0;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+struct reftypes_bychar {
+	int first[256];  /* earliest reftype whose type starts with each (lowercased) byte */
+	int empty;       /* earliest reftype with an empty type, matching anything */
+};
+
+/* reftypes_index_types()
+ *
+ * Chain together the reftypes whose types start with the same letter
+ * (ignoring case), in table order, so get_reftype() only has to try
+ * the ones that could be a prefix of the type it's given.
+ */
+static void
+reftypes_index_types( variants all[], int nall )
+{
+	reftypes_bychar *b;
+	int i, c, last[256];
+
+	b = ( reftypes_bychar * ) malloc( sizeof( reftypes_bychar ) );
+	if ( !b ) return;
+
+	b->empty = -1;
+	for ( c=0; c<256; ++c ) b->first[c] = last[c] = -1;
+
+	for ( i=0; i<nall; ++i ) {
+		all[i].typelen  = strlen( all[i].type );
+		all[i].nexttype = -1;
+		if ( all[i].typelen==0 ) {
+			if ( b->empty==-1 ) b->empty = i;
+			continue;
+		}
+		c = tolower( ( unsigned char ) all[i].type[0] );
+		if ( last[c]==-1 ) b->first[c] = i;
+		else all[ last[c] ].nexttype = i;
+		last[c] = i;
+	}
+
+	all[0].bychar = b;
+}
+
+/* reftypes_index()
+ *
+ * Index the types and the tags of every reftype in all[] so that
+ * get_reftype() and process_findoldtag() don't have to scan them, and
+ * collect the ALWAYS/DEFAULT tags bibl_read() adds to each reference.
+ * Called from bibl_initparams(); a table is only indexed on the first
+ * call, so later calls (from any thread) leave the index alone while
+ * it is being read. Anything that couldn't be indexed is still
+ * searched linearly.
+ */
+void
+reftypes_index( variants all[], int nall )
+{
+	int i;
+
+	bu_mutex_lock( &reftypes_index_lock );
+
+	if ( nall>0 && all[0].indexed==0 ) {
+		reftypes_index_types( all, nall );
+		for ( i=0; i<nall; ++i )
+			all[i].indexed = reftypes_index_variant( &(all[i]) ) ? 1 : -1;
+	}
+
+	bu_mutex_unlock( &reftypes_index_lock );
+}
+
+/* find_reftype()
+ *
+ * Returns the first reftype in all[] whose type is a prefix of p
+ * (ignoring case), or -1.
+ */
+static int
+find_reftype( const char *p, variants *all, int nall )
+{
+	reftypes_bychar *b = NULL;
+	int i;
+
+	if ( nall>0 ) b = all[0].bychar;
+
+	if ( b ) {
+		for ( i=b->first[ tolower( ( unsigned char ) *p ) ]; i!=-1; i=all[i].nexttype ) {
+			if ( b->empty!=-1 && i > b->empty ) break;
+			if ( !strncasecmp( all[i].type, p, all[i].typelen ) )
+				return i;
+		}
+		return b->empty;
+	}
 
 	for ( i=0; i<nall; ++i ) {
 		if ( !strncasecmp( all[i].type, p, strlen(all[i].type) ) ) 
 			return i;
 	}
 
+	return -1;
+}
+
+int
+get_reftype( const char *p, long refnum, char *progname, variants *all, int nall, char *tag, int *is_default, int chattiness )
+{
+	int i;
+
+	p = skip_ws( p );
+
+	*is_default = 0;
+
+	i = find_reftype( p, all, nall );
+	if ( i!=-1 ) return i;
+
 	*is_default = 1;
 
 	if ( chattiness==REFTYPE_CHATTY ) {
@@ -44,6 +224,8 @@ process_findoldtag( const char *oldtag, int reftype, variants all[], int nall )
         int i;
 
         v = &(all[reftype]);
+        if ( v->indexed==1 ) return strhash_find( &(v->tagindex), oldtag );
+
         for ( i=0; i<v->ntags; ++i ) {
                 if ( !strcasecmp( (v->tags[i]).oldstr, oldtag ) )
                         return i;
@@ -9,6 +9,8 @@
 #ifndef REFTYPES_H
 #define REFTYPES_H
 
+#include "strhash.h"
+
 #define REFTYPE_CHATTY  (0)
 #define REFTYPE_SILENT  (1)
 
@@ -50,12 +52,35 @@ typedef struct {
 	int  level;
 } lookups;
 
+/* ALWAYS/DEFAULT lookups with newstr "TAG|value" already split */
+typedef struct {
+	char *tag;
+	char *value;
+	int  level;
+} reftypes_add;
+
+typedef struct reftypes_bychar reftypes_bychar;
+
+/* variants
+ *
+ * Tables are written with just type/tags/ntags; the remaining members
+ * start zeroed and are filled in by reftypes_index().
+ */
 typedef struct {
 	char    type[25];
 	lookups *tags;
 	int     ntags;
+	int     indexed;   /* 0 not yet, 1 tagindex/always/defaults built, -1 couldn't build */
+	strhash tagindex;  /* oldstr -> first position in tags, ignoring case */
+	reftypes_add *always, *defaults; /* ALWAYS and DEFAULT tags, in table order */
+	int     nalways, ndefaults;
+	int     typelen;   /* strlen( type ) */
+	int     nexttype;  /* next reftype whose type starts with the same letter, or -1 */
+	reftypes_bychar *bychar; /* all[0] only: first reftype for each letter */
 } variants;
 
+void reftypes_index( variants all[], int nall );
+
 int get_reftype( const char *q, long refnum, char *progname, variants *all, int nall, char *tag, int *is_default, int chattiness );
 int process_findoldtag( const char *oldtag, int reftype, variants all[], int nall );
 int translate_oldtag( const char *oldtag, int reftype, variants all[], int nall, int *processingtype, int *level, char **newtag );
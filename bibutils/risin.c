@@ -29,7 +29,7 @@ extern int ris_nall;
  PUBLIC: void risin_initparams()
 *****************************************************/
 
-static int risin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int risin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int risin_processf( fields *risin, const char *p, const char *filename, long nref, param *pm );
 static int risin_typef( fields *risin, const char *filename, int nref, param *p );
 static int risin_convertf( fields *risin, fields *info, int reftype, param *p );
@@ -48,7 +48,8 @@ risin_initparams( param *pm, const char *progname )
 	pm->addcount         = 0;
 	pm->output_raw       = 0;
 
-	pm->readf    = risin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = risin_readf;
 	pm->processf = risin_processf;
 	pm->cleanf   = NULL;
 	pm->typef    = risin_typef;
@@ -129,34 +130,51 @@ is_ris_end_tag( char *p )
 	return 0;
 }
 
+/* risin_readf()
+ *
+ * Lines are looked at where inbuf_getline() leaves them. Only a line
+ * read too far (the 'TY  - ' of the next reference, when 'ER  - ' is
+ * missing) is copied into line, to be looked at again next time.
+ */
 static int
-readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
-{
-	if ( line->len ) return 1;
-	else return str_fget( fp, buf, bufsize, bufpos, line );
-}
-
-static int
-risin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+risin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	int haveref = 0, inref = 0, readtoofar = 0;
-	char *p;
+	const char *start, *p, *nul;
+	size_t len, n;
+	char head[8];
 
 	*fcharset = CHARSET_UNKNOWN;
 
-	while ( !haveref && readmore( fp, buf, bufsize, bufpos, line ) ) {
+	while ( !haveref ) {
+
+		if ( line->len ) {
+			start = str_cstr( line );
+			len   = line->len;
+		}
+		else if ( !inbuf_getline( in, &start, &len ) ) break;
+
+		if ( len==0 ) continue;
 
-		if ( str_is_empty( line ) ) continue;
+		p = start;
+		n = len;
 
-		p = str_cstr( line );
+		/* as a '\0'-terminated copy would, stop at a '\0' */
+		nul = memchr( p, '\0', n );
+		if ( nul ) n = nul - p;
 
-		if ( utf8_is_bom( p ) ) {
+		if ( n >= 3 && utf8_is_bom( p ) ) {
 			*fcharset = CHARSET_UNICODE;
 			p += 3;
+			n -= 3;
 		}
 
+		/* the line isn't '\0'-terminated; the tags fit in seven bytes */
+		memcpy( head, p, ( n < 7 ) ? n : 7 );
+		head[ ( n < 7 ) ? n : 7 ] = '\0';
+
 		/* References are bounded by tags 'TY  - ' && 'ER  - ' */
-		if ( is_ris_start_tag( p ) ) {
+		if ( is_ris_start_tag( head ) ) {
 			if ( !inref ) inref = 1;
 			else {
 				/* we've read too far.... */
@@ -165,25 +183,26 @@ risin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *refe
 			}
 		}
 
-		if ( is_ris_tag( p ) ) {
+		if ( is_ris_tag( head ) ) {
 			if ( !inref ) {
 				fprintf(stderr,"Warning.  Tagged line not "
 					"in properly started reference.\n");
-				fprintf(stderr,"Ignored: '%s'\n", p );
-			} else if ( is_ris_end_tag( p ) ) {
+				fprintf(stderr,"Ignored: '%.*s'\n", ( int ) n, p );
+			} else if ( is_ris_end_tag( head ) ) {
 				inref = 0;
 			} else {
 				str_addchar( reference, '\n' );
-				str_strcatc( reference, p );
+				str_segcat( reference, ( char * ) p, ( char * ) p + n );
 			}
 		}
 		/* not a tag, but we'll append to last values ...*/
-		else if ( inref && !is_ris_end_tag( p ) ) {
+		else if ( inref && !is_ris_end_tag( head ) ) {
 			str_addchar( reference, '\n' );
-			str_strcatc( reference, p );
+			if ( n ) str_segcat( reference, ( char * ) p, ( char * ) p + n );
 		}
 		if ( !inref && reference->len ) haveref = 1;
 		if ( !readtoofar ) str_empty( line );
+		else if ( !line->len ) str_segcat( line, ( char * ) start, ( char * ) start + len );
 	}
 
 	if ( inref ) haveref = 1;
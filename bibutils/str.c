@@ -64,6 +64,22 @@
 #endif
 
 
+/* str_arenarealloc()
+ *
+ * Arena memory can't be resized, so take a new buffer and copy the
+ * string over; the old one stays in the arena until it is deleted.
+ */
+static char *
+str_arenarealloc( str *s, unsigned long size )
+{
+	char *newptr;
+
+	newptr = (char *) arena_alloc( s->mem, sizeof( *(s->data) ) * size );
+	if ( newptr && s->data ) memcpy( newptr, s->data, s->dim );
+
+	return newptr;
+}
+
 /* Clear memory in resize/free if STR_PARANOIA defined */
 
 #ifndef STR_PARANOIA
@@ -80,7 +96,8 @@ str_realloc( str *s, unsigned long minsize )
 	size = 2 * s->dim;
 	if (size < minsize) size = minsize;
 
-	newptr = (char *) realloc( s->data, sizeof( *(s->data) )*size );
+	if ( s->mem ) newptr = str_arenarealloc( s, size );
+	else newptr = (char *) realloc( s->data, sizeof( *(s->data) )*size );
 	if ( !newptr ) handle_memerr( s, __FUNCTION__ );
 
 	s->data = newptr;
@@ -104,12 +121,13 @@ str_realloc( str *s, unsigned long minsize )
 	size = 2 * s->dim;
 	if ( size < minsize ) size = minsize;
 
-	newptr = (char *) malloc( sizeof( *(s->data) ) * size );
+	if ( s->mem ) newptr = str_arenarealloc( s, size );
+	else newptr = (char *) malloc( sizeof( *(s->data) ) * size );
 	if ( !newptr ) handle_memerr( s, __FUNCTION__ );
 
 	if ( s->data ) {
 		str_nullify( s );
-		free( s->data );
+		if ( !s->mem ) free( s->data );
 	}
 	s->data = newptr;
 	s->dim = size;
@@ -130,9 +148,22 @@ str_init( str *s )
 	s->dim = 0;
 	s->len = 0;
 	s->data = NULL;
+	s->mem = NULL;
 	str_clear_status( s );
 }
 
+/* str_initarena()
+ *
+ * Initialize a str whose buffers come from mem; they are released
+ * with the arena, not by str_free().
+ */
+void
+str_initarena( str *s, arena *mem )
+{
+	str_init( s );
+	s->mem = mem;
+}
+
 void
 str_initstr( str *s, str *from )
 {
@@ -210,7 +241,8 @@ str_initalloc( str *s, unsigned long minsize )
 	unsigned long size = str_initlen;
 	assert( s );
 	if ( minsize > str_initlen ) size = minsize;
-	s->data = (char *) malloc( sizeof( *(s->data) ) * size );
+	if ( s->mem ) s->data = (char *) arena_alloc( s->mem, sizeof( *(s->data) ) * size );
+	else s->data = (char *) malloc( sizeof( *(s->data) ) * size );
 	if ( !s->data ) {
 		fprintf(stderr,"Error.  Cannot allocate memory in str_initalloc, requested %lu characters.\n", size );
 		exit( EXIT_FAILURE );
@@ -225,8 +257,10 @@ str *
 str_new( void )
 {
 	str *s = (str *) malloc( sizeof( *s ) );
-	if ( s )
+	if ( s ) {
+		s->mem = NULL;
 		str_initalloc( s, str_initlen );
+	}
 	return s;
 }
 
@@ -236,11 +270,12 @@ str_free( str *s )
 	assert( s );
 	if ( s->data ) {
 		str_nullify( s );
-		free( s->data );
+		if ( !s->mem ) free( s->data );
 	}
 	s->dim = 0;
 	s->len = 0;
 	s->data = NULL;
+	s->mem = NULL;
 }
 
 void
@@ -411,9 +446,6 @@ str_strcatc( str *s, const char *from )
 void
 str_segcat( str *s, char *startat, char *endat )
 {
-	unsigned long n;
-	char *p;
-
 	assert( s && startat && endat );
 	assert( (size_t) startat < (size_t) endat );
 
@@ -421,14 +453,7 @@ str_segcat( str *s, char *startat, char *endat )
 
 	if ( startat==endat ) return;
 
-	n = 0;
-	p = startat;
-	while ( p!=endat ) {
-		n++;
-		p++;
-	}
-
-	str_strcat_internal( s, startat, n );
+	str_strcat_internal( s, startat, ( unsigned long ) ( endat - startat ) );
 }
 
 void
@@ -681,12 +706,17 @@ int
 str_fget( FILE *fp, char *buf, int bufsize, int *pbufpos, str *outs )
 {
 	int  bufpos = *pbufpos, done = 0;
+	size_t n;
 	char *ok;
 	assert( fp && outs );
 	str_empty( outs );
 	while ( !done ) {
-		while ( buf[bufpos] && buf[bufpos]!='\r' && buf[bufpos]!='\n' )
-			str_addchar( outs, buf[bufpos++] );
+		/* copy the rest of the line held in buf in one go */
+		n = strcspn( buf+bufpos, "\r\n" );
+		if ( n ) {
+			str_strcat_internal( outs, buf+bufpos, n );
+			bufpos += n;
+		}
 		if ( buf[bufpos]=='\0' ) {
 			ok = fgets( buf, bufsize, fp );
 			bufpos=*pbufpos=0;
@@ -729,6 +759,7 @@ str_tolower( str *s )
 void
 str_swapstrings( str *s1, str *s2 )
 {
+	arena *tmpm;
 	char *tmpp;
 	int tmp;
 
@@ -748,6 +779,11 @@ str_swapstrings( str *s1, str *s2 )
 	tmpp = s1->data;
 	s1->data = s2->data;
 	s2->data = tmpp;
+
+	/* and whoever owns it */
+	tmpm = s1->mem;
+	s1->mem = s2->mem;
+	s2->mem = tmpm;
 }
 
 void
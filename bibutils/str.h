@@ -15,11 +15,13 @@
 #define STR_MEMERR (-1)
 
 #include <stdio.h>
+#include "arena.h"
 
 typedef struct str {
 	char *data;
 	unsigned long dim;
 	unsigned long len;
+	arena *mem; /* if set, data is allocated from (and owned by) mem */
 #ifndef STR_SMALL
 	int status;
 #endif
@@ -29,6 +31,7 @@ str *  str_new         ( void );
 void   str_delete      ( str *s );
 
 void   str_init        ( str *s );
+void   str_initarena   ( str *s, arena *mem );
 void   str_initstr     ( str *s, str *from );
 void   str_initstrc    ( str *s, const char *initstr );
 void   str_initstrsc   ( str *s, ... );
@@ -13,6 +13,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include "bu_thread.h"
 #include "latex.h"
 #include "entities.h"
 #include "utf8.h"
@@ -81,21 +82,28 @@ addgb18030char( str *s, unsigned int ch, int xmlout )
 static void
 addlatexchar( str *s, unsigned int ch, int xmlout, int utf8out )
 {
-	char buf[512];
-	uni2latex( ch, buf, sizeof( buf ) );
+	const char *latex;
+	int len;
+
+	latex = uni2latex_lookup( ch, &len );
+	if ( latex ) {
+		if ( len ) str_segcat( s, ( char * ) latex, ( char * ) latex + len );
+	}
 	/* If the unicode character isn't recognized as latex output
 	 * a '?' unless the user has requested unicode output.  If so,
 	 * output the unicode.
 	 */
-	if ( utf8out && !strcmp( buf, "?" ) ) {
+	else if ( utf8out && ( ch=='?' || ch > 127 ) ) {
 		addutf8char( s, ch, xmlout );
+	} else if ( ch < 128 ) {
+		str_addchar( s, ch );
 	} else {
-		str_strcatc( s, buf );
+		str_addchar( s, '?' );
 	}
 }
 
 /*
- * get_unicode()
+ * Decoders
  * 
  *   This can be a little tricky.  If the character is simply encoded
  *   such as UTF8 for > 128 or by numeric xml entities such as "&#534;"
@@ -105,13 +113,289 @@ addlatexchar( str *s, unsigned int ch, int xmlout, int utf8out )
  *   like "&amp;", then we'll get the Unicode value (because our lists only
  *   keep the Unicode equivalent).
  *
- *   The unicode variable indicates whether or not a Unicode-based listing
- *   was used to convert the character (remember that charsetin could be
- *   Unicode independently).
+ *   Characters that weren't found through a Unicode-based listing are
+ *   then looked up in charsetin, unless charsetin is itself Unicode.
+ *
+ *   Each decoder handles one combination of input options, so that
+ *   str_converter_init() can pick the right one once instead of
+ *   re-testing the options for every character.
+ */
+
+static unsigned int
+decode_byte( str_converter *c, str *s, unsigned int *pi )
+{
+	unsigned int ch = (unsigned int) s->data[*pi];
+	*pi = *pi + 1;
+	return ch;
+}
+
+static unsigned int
+decode_byte_charset( str_converter *c, str *s, unsigned int *pi )
+{
+	unsigned int ch = (unsigned int) s->data[*pi];
+	*pi = *pi + 1;
+	return charset_lookupchar( c->charsetin, ch );
+}
+
+static unsigned int
+decode_utf8( str_converter *c, str *s, unsigned int *pi )
+{
+	return utf8_decode( s->data, pi );
+}
+
+static unsigned int
+decode_utf8_charset( str_converter *c, str *s, unsigned int *pi )
+{
+	return charset_lookupchar( c->charsetin, utf8_decode( s->data, pi ) );
+}
+
+static unsigned int
+decode_gb18030( str_converter *c, str *s, unsigned int *pi )
+{
+	return gb18030_decode( s->data, pi );
+}
+
+static unsigned int
+decode_latex( str_converter *c, str *s, unsigned int *pi )
+{
+	unsigned int ch;
+	int unicode = 0;
+	ch = latex2char( s->data, pi, &unicode );
+	if ( !unicode && c->charsetin!=CHARSET_UNICODE )
+		ch = charset_lookupchar( c->charsetin, ch );
+	return ch;
+}
+
+/* Must handle bibtex files in UTF8/Unicode */
+static unsigned int
+decode_latex_utf8( str_converter *c, str *s, unsigned int *pi )
+{
+	if ( s->data[*pi] & 128 ) return utf8_decode( s->data, pi );
+	return decode_latex( c, s, pi );
+}
+
+static unsigned int
+decode_xml( str_converter *c, str *s, unsigned int *pi )
+{
+	unsigned int ch;
+	int unicode = 0, err = 0;
+	if ( s->data[*pi]!='&' ) return c->decode_xml_inner( c, s, pi );
+	ch = decode_entity( s->data, pi, &unicode, &err );
+	/* GB18030 has no table to look entities up in; they're Unicode */
+	if ( !unicode && c->charsetin!=CHARSET_UNICODE && c->charsetin!=CHARSET_GB18030 )
+		ch = charset_lookupchar( c->charsetin, ch );
+	return ch;
+}
+
+/*
+ * Encoders
+ */
+
+static void
+encode_latex( str_converter *c, str *s, unsigned int ch )
+{
+	addlatexchar( s, ch, c->xmlout, c->utf8out );
+}
+
+static void
+encode_utf8( str_converter *c, str *s, unsigned int ch )
+{
+	addutf8char( s, ch, c->xmlout );
+}
+
+static void
+encode_gb18030( str_converter *c, str *s, unsigned int ch )
+{
+	addgb18030char( s, ch, c->xmlout );
+}
+
+static void
+encode_charset( str_converter *c, str *s, unsigned int ch )
+{
+	str_addchar( s, charset_lookupuni( c->charsetout, ch ) );
+}
+
+static void
+encode_charset_xml( str_converter *c, str *s, unsigned int ch )
+{
+	addxmlchar( s, charset_lookupuni( c->charsetout, ch ) );
+}
+
+/* ASCII bytes that a conversion may change, by the option that makes
+ * them special; NUL and bytes over 127 are always special
+ */
+#define ASCII_ALWAYS   (1)
+#define ASCII_XMLIN    (2)
+#define ASCII_LATEXIN  (4)
+#define ASCII_LATEXOUT (8)
+#define ASCII_XMLOUT   (16)
+
+static unsigned char ascii_special[256];
+static bu_once_t ascii_special_once = BU_ONCE_INIT;
+
+static void
+ascii_special_build( void )
+{
+	int c;
+
+	for ( c=0; c<256; ++c ) {
+		if ( c=='\0' || c > 127 ) {
+			ascii_special[c] = ASCII_ALWAYS;
+			continue;
+		}
+		ascii_special[c] = 0;
+		if ( c=='&' ) ascii_special[c] |= ASCII_XMLIN;
+		if ( !latex2char_plain( c ) ) ascii_special[c] |= ASCII_LATEXIN;
+		if ( !uni2latex_plain( c ) ) ascii_special[c] |= ASCII_LATEXOUT;
+		if ( strchr( "\"&'<>", c ) ) ascii_special[c] |= ASCII_XMLOUT;
+	}
+}
+
+/* str_converter_init()
  *
- *   The charset variable is used to keep track of what character set
- *   the character is in prior to conversion.
+ * Choose the decoder and encoder for one set of conversion options, so
+ * that a str_converter can be set up once and applied to many strs.
+ */
+void
+str_converter_init( str_converter *c,
+	int charsetin,  int latexin,  int utf8in,  int xmlin,
+	int charsetout, int latexout, int utf8out, int xmlout )
+{
+	if ( charsetin==CHARSET_UNKNOWN ) charsetin = CHARSET_DEFAULT;
+	if ( charsetout==CHARSET_UNKNOWN ) charsetout = CHARSET_DEFAULT;
+
+	c->charsetin  = charsetin;
+	c->charsetout = charsetout;
+	c->utf8out    = utf8out;
+	c->xmlout     = xmlout;
+
+	if ( charsetin==CHARSET_GB18030 ) c->decode = decode_gb18030;
+	else if ( latexin && utf8in ) c->decode = decode_latex_utf8;
+	else if ( latexin ) c->decode = decode_latex;
+	else if ( utf8in ) {
+		if ( charsetin==CHARSET_UNICODE ) c->decode = decode_utf8;
+		else c->decode = decode_utf8_charset;
+	} else {
+		if ( charsetin==CHARSET_UNICODE ) c->decode = decode_byte;
+		else c->decode = decode_byte_charset;
+	}
+	if ( xmlin ) {
+		c->decode_xml_inner = c->decode;
+		c->decode = decode_xml;
+	} else c->decode_xml_inner = NULL;
+
+	if ( latexout ) c->encode = encode_latex;
+	else if ( utf8out ) c->encode = encode_utf8;
+	else if ( charsetout==CHARSET_GB18030 ) c->encode = encode_gb18030;
+	else if ( xmlout ) c->encode = encode_charset_xml;
+	else c->encode = encode_charset;
+
+	/* see ascii_unchanged() */
+	c->ascii_mask = 0;
+	if ( !charset_asciicompatible( charsetin ) ) return;
+	if ( !latexout && !utf8out && !charset_asciicompatible( charsetout ) ) return;
+
+	bu_once( &ascii_special_once, ascii_special_build );
+
+	c->ascii_mask = ASCII_ALWAYS;
+	if ( xmlin )    c->ascii_mask |= ASCII_XMLIN;
+	if ( latexin )  c->ascii_mask |= ASCII_LATEXIN;
+	if ( latexout ) c->ascii_mask |= ASCII_LATEXOUT;
+	if ( xmlout )   c->ascii_mask |= ASCII_XMLOUT;
+}
+
+/* ascii_unchanged()
  *
+ * Returns how many bytes at the start of s go through the conversion
+ * unchanged: the decoder takes each of them on its own and the encoder
+ * writes it straight back.
+ */
+static unsigned long
+ascii_unchanged( str_converter *c, str *s )
+{
+	const unsigned char *p = ( const unsigned char * ) s->data;
+	unsigned char mask = c->ascii_mask;
+	unsigned long i = 0;
+
+	if ( !mask ) return 0;
+
+	while ( i + 4 <= s->len &&
+	        !( ( ascii_special[ p[i] ]   | ascii_special[ p[i+1] ] |
+	             ascii_special[ p[i+2] ] | ascii_special[ p[i+3] ] ) & mask ) )
+		i += 4;
+	while ( i < s->len && !( ascii_special[ p[i] ] & mask ) )
+		i++;
+
+	return i;
+}
+
+/*
+ * Returns 1 on memory error condition
+ */
+int
+str_converter_apply( str_converter *c, str *s )
+{
+	unsigned int pos = 0;
+	unsigned long n;
+	unsigned int ch;
+	str ns;
+
+	if ( !s || s->len==0 ) return 1;
+
+	/* Most fields are plain ASCII that no option touches: leave them
+	 * be, and only convert what follows the unchanged part.
+	 */
+	n = ascii_unchanged( c, s );
+	if ( n==s->len ) return 1;
+
+	/* Ensure that string is internally allocated.
+	 * This fixes NULL pointer derefernce in CVE-2018-10775 in bibutils
+	 * as a string with a valid data pointer is potentially replaced
+	 * by a string without a valid data pointer due to it being invalid
+	 * unicode.
+	 * This probably also fixes CVE-2018-10773 and CVE-2018-10774 which
+	 * are NULL dereferences also likely due to a fuzzer, but without
+	 * test cases in the report, I can't be completely sure.
+	 *
+	 * The new string comes from the same arena (if any) as s, since
+	 * the two are swapped below.
+	 */
+	str_initarena( &ns, s->mem );
+	str_strcpyc( &ns, "" );
+
+	if ( n ) {
+		str_segcpy( &ns, s->data, s->data + n );
+		pos = n;
+	}
+
+	while ( s->data[pos] ) {
+		ch = c->decode( c, s, &pos );
+		c->encode( c, &ns, ch );
+	}
+
+	str_swapstrings( s, &ns );
+	str_free( &ns );
+
+	return 1;
+}
+
+int
+str_convert( str *s,
+	int charsetin,  int latexin,  int utf8in,  int xmlin,
+	int charsetout, int latexout, int utf8out, int xmlout )
+{
+	str_converter c;
+
+	if ( !s || s->len==0 ) return 1;
+
+	str_converter_init( &c, charsetin, latexin, utf8in, xmlin,
+		charsetout, latexout, utf8out, xmlout );
+
+	return str_converter_apply( &c, s );
+}
+
+/*
+ * The generic path, for str_convert_generic()
  */
 
 static unsigned int
@@ -137,12 +421,12 @@ get_unicode( str *s, unsigned int *pi, int charsetin, int latexin, int utf8in, i
 		ch = (unsigned int) s->data[*pi];
 		*pi = *pi + 1;
 	}
-	if ( !unicode && charsetin!=CHARSET_UNICODE )
+	if ( !unicode && charsetin!=CHARSET_UNICODE && charsetin!=CHARSET_GB18030 )
 		ch = charset_lookupchar( charsetin, ch );
 	return ch;
 }
 
-static int
+static void
 write_unicode( str *s, unsigned int ch, int charsetout, int latexout,
 		int utf8out, int xmlout )
 {
@@ -158,47 +442,39 @@ write_unicode( str *s, unsigned int ch, int charsetout, int latexout,
 		if ( xmlout ) addxmlchar( s, c );
 		else str_addchar( s, c );
 	}
-	return 1;
 }
 
-/*
- * Returns 1 on memory error condition
+/* str_convert_generic()
+ *
+ * The conversion as it was before the decoders and encoders were split
+ * up: every option tested again for every character, and no ASCII
+ * fast path. Kept as the reference that str_converter_apply() has to
+ * match; see bibutils/test/str_conv_test.c.
  */
 int
-str_convert( str *s,
+str_convert_generic( str *s,
 	int charsetin,  int latexin,  int utf8in,  int xmlin,
 	int charsetout, int latexout, int utf8out, int xmlout )
 {
 	unsigned int pos = 0;
 	unsigned int ch;
 	str ns;
-	int ok = 1;
 
-	if ( !s || s->len==0 ) return ok;
+	if ( !s || s->len==0 ) return 1;
 
-	/* Ensure that string is internally allocated.
-	 * This fixes NULL pointer derefernce in CVE-2018-10775 in bibutils
-	 * as a string with a valid data pointer is potentially replaced
-	 * by a string without a valid data pointer due to it being invalid
-	 * unicode.
-	 * This probably also fixes CVE-2018-10773 and CVE-2018-10774 which
-	 * are NULL dereferences also likely due to a fuzzer, but without
-	 * test cases in the report, I can't be completely sure.
-	 */
-	str_initstrc( &ns, "" );
+	str_initarena( &ns, s->mem );
+	str_strcpyc( &ns, "" );
 
 	if ( charsetin==CHARSET_UNKNOWN ) charsetin = CHARSET_DEFAULT;
 	if ( charsetout==CHARSET_UNKNOWN ) charsetout = CHARSET_DEFAULT;
 
 	while ( s->data[pos] ) {
 		ch = get_unicode( s, &pos, charsetin, latexin, utf8in, xmlin );
-		ok = write_unicode( &ns, ch, charsetout, latexout, utf8out, xmlout );
-		if ( !ok ) goto out;
+		write_unicode( &ns, ch, charsetout, latexout, utf8out, xmlout );
 	}
 
 	str_swapstrings( s, &ns );
-out:
 	str_free( &ns );
 
-	return ok;
+	return 1;
 }
@@ -15,9 +15,31 @@
 
 #include "str.h"
 
+/* str_converter
+ *
+ * One set of conversion options, with the per-character decoder and
+ * encoder for them chosen up front by str_converter_init().
+ */
+typedef struct str_converter {
+	unsigned int (*decode)( struct str_converter *c, str *s, unsigned int *pi );
+	unsigned int (*decode_xml_inner)( struct str_converter *c, str *s, unsigned int *pi );
+	void (*encode)( struct str_converter *c, str *s, unsigned int ch );
+	int charsetin, charsetout;
+	int utf8out, xmlout;
+	unsigned char ascii_mask;  /* 0 if ASCII may not pass through as is */
+} str_converter;
+
+extern void str_converter_init( str_converter *c,
+		int charsetin, int latexin, int utf8in, int xmlin,
+		int charsetout, int latexout, int utf8out, int xmlout );
+extern int str_converter_apply( str_converter *c, str *s );
+
 extern int str_convert( str *s,
 		int charsetin, int latexin, int utf8in, int xmlin, 
 		int charsetout, int latexout, int utf8out, int xmlout );
+extern int str_convert_generic( str *s,
+		int charsetin, int latexin, int utf8in, int xmlin,
+		int charsetout, int latexout, int utf8out, int xmlout );
 
 #endif
 
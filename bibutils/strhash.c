@@ -0,0 +1,288 @@
+/*
+ * strhash.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Implements a simple open-addressing (linear probing) hash table
+ * from strings to long values
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <assert.h>
+#include "strhash.h"
+
+#define STRHASH_MINALLOC (64)
+
+void
+strhash_init( strhash *h, int nocase )
+{
+	assert( h );
+
+	h->n      = h->max = 0;
+	h->nocase = nocase;
+	h->keys   = NULL;
+	h->values = NULL;
+	h->filled = NULL;
+}
+
+void
+strhash_free( strhash *h )
+{
+	unsigned long i;
+
+	assert( h );
+
+	for ( i=0; i<h->max; ++i )
+		if ( h->filled[i] ) str_free( &(h->keys[i]) );
+
+	if ( h->keys )   free( h->keys );
+	if ( h->values ) free( h->values );
+	if ( h->filled ) free( h->filled );
+
+	strhash_init( h, h->nocase );
+}
+
+void
+strhash_empty( strhash *h )
+{
+	unsigned long i;
+
+	assert( h );
+
+	for ( i=0; i<h->max; ++i ) {
+		if ( h->filled[i] ) str_free( &(h->keys[i]) );
+		h->filled[i] = 0;
+	}
+
+	h->n = 0;
+}
+
+/* strhash_hash()
+ *
+ * FNV-1a over the key bytes, folding ASCII case if requested.
+ */
+unsigned long
+strhash_hash( const char *key, unsigned long len, int nocase )
+{
+	unsigned long hash = 2166136261UL;
+	unsigned char ch;
+	unsigned long i;
+
+	for ( i=0; i<len; ++i ) {
+		ch = ( unsigned char ) key[i];
+		if ( nocase ) ch = tolower( ch );
+		hash ^= ch;
+		hash *= 16777619UL;
+	}
+
+	return hash;
+}
+
+static int
+strhash_keymatch( strhash *h, unsigned long pos, const char *key, unsigned long len )
+{
+	str *s = &(h->keys[pos]);
+
+	if ( s->len != len ) return 0;
+	if ( len==0 ) return 1;
+
+	if ( h->nocase ) return !strncasecmp( s->data, key, len );
+	else return !memcmp( s->data, key, len );
+}
+
+/* strhash_slot()
+ *
+ * Return the slot holding key, or the empty slot where it would go.
+ */
+static unsigned long
+strhash_slot( strhash *h, const char *key, unsigned long len )
+{
+	unsigned long mask = h->max - 1;
+	unsigned long pos;
+
+	pos = strhash_hash( key, len, h->nocase ) & mask;
+
+	while ( h->filled[pos] && !strhash_keymatch( h, pos, key, len ) )
+		pos = ( pos + 1 ) & mask;
+
+	return pos;
+}
+
+static int
+strhash_alloc( strhash *h, unsigned long alloc )
+{
+	h->keys   = ( str * ) malloc( sizeof( str ) * alloc );
+	h->values = ( long * ) malloc( sizeof( long ) * alloc );
+	h->filled = ( unsigned char * ) calloc( alloc, sizeof( unsigned char ) );
+
+	if ( !h->keys || !h->values || !h->filled ) {
+		if ( h->keys )   free( h->keys );
+		if ( h->values ) free( h->values );
+		if ( h->filled ) free( h->filled );
+		strhash_init( h, h->nocase );
+		return STRHASH_MEMERR;
+	}
+
+	h->max = alloc;
+	h->n   = 0;
+
+	return STRHASH_OK;
+}
+
+/* strhash_rehash()
+ *
+ * Move all keys into a table of size alloc (a power of two); the
+ * key strings themselves are moved, not copied.
+ */
+static int
+strhash_rehash( strhash *h, unsigned long alloc )
+{
+	strhash old = *h;
+	unsigned long i, pos;
+	int status;
+
+	status = strhash_alloc( h, alloc );
+	if ( status!=STRHASH_OK ) {
+		*h = old;
+		return status;
+	}
+
+	for ( i=0; i<old.max; ++i ) {
+		if ( !old.filled[i] ) continue;
+		pos = strhash_slot( h, old.keys[i].data, old.keys[i].len );
+		h->keys[pos]   = old.keys[i];
+		h->values[pos] = old.values[i];
+		h->filled[pos] = 1;
+		h->n++;
+	}
+
+	free( old.keys );
+	free( old.values );
+	free( old.filled );
+
+	return STRHASH_OK;
+}
+
+static int
+strhash_ensure_space( strhash *h )
+{
+	if ( h->max==0 ) return strhash_alloc( h, STRHASH_MINALLOC );
+
+	/* keep load factor at or below 1/2 */
+	if ( ( h->n + 1 ) * 2 > h->max ) return strhash_rehash( h, h->max * 2 );
+
+	return STRHASH_OK;
+}
+
+static int
+strhash_put( strhash *h, const char *key, unsigned long len, long value, int replace )
+{
+	unsigned long pos;
+	int status;
+
+	status = strhash_ensure_space( h );
+	if ( status!=STRHASH_OK ) return status;
+
+	pos = strhash_slot( h, key, len );
+
+	if ( h->filled[pos] ) {
+		if ( replace ) h->values[pos] = value;
+		return STRHASH_OK;
+	}
+
+	str_init( &(h->keys[pos]) );
+	if ( len ) str_segcpy( &(h->keys[pos]), ( char * ) key, ( char * ) key + len );
+	if ( str_memerr( &(h->keys[pos]) ) ) {
+		str_free( &(h->keys[pos]) );
+		return STRHASH_MEMERR;
+	}
+
+	h->values[pos] = value;
+	h->filled[pos] = 1;
+	h->n++;
+
+	return STRHASH_OK;
+}
+
+/* strhash_add()
+ *
+ * Add key with value unless key is already present, in which case
+ * the earlier value is kept.
+ *
+ * Returns STRHASH_OK/STRHASH_MEMERR
+ */
+int
+strhash_add( strhash *h, const char *key, long value )
+{
+	assert( h );
+	assert( key );
+
+	return strhash_put( h, key, strlen( key ), value, 0 );
+}
+
+int
+strhash_addn( strhash *h, const char *key, unsigned long len, long value )
+{
+	assert( h );
+	assert( key || len==0 );
+
+	return strhash_put( h, key, len, value, 0 );
+}
+
+/* strhash_set()
+ *
+ * Add key with value, replacing the value of an existing key.
+ *
+ * Returns STRHASH_OK/STRHASH_MEMERR
+ */
+int
+strhash_set( strhash *h, const char *key, long value )
+{
+	assert( h );
+	assert( key );
+
+	return strhash_put( h, key, strlen( key ), value, 1 );
+}
+
+int
+strhash_setn( strhash *h, const char *key, unsigned long len, long value )
+{
+	assert( h );
+	assert( key || len==0 );
+
+	return strhash_put( h, key, len, value, 1 );
+}
+
+/* strhash_findn()
+ *
+ * Returns the value stored for the first len bytes of key,
+ * or STRHASH_NOTFOUND
+ */
+long
+strhash_findn( strhash *h, const char *key, unsigned long len )
+{
+	unsigned long pos;
+
+	assert( h );
+	assert( key || len==0 );
+
+	if ( h->n==0 ) return STRHASH_NOTFOUND;
+
+	pos = strhash_slot( h, key, len );
+	if ( !h->filled[pos] ) return STRHASH_NOTFOUND;
+
+	return h->values[pos];
+}
+
+long
+strhash_find( strhash *h, const char *key )
+{
+	assert( key );
+
+	return strhash_findn( h, key, strlen( key ) );
+}
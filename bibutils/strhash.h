@@ -0,0 +1,50 @@
+/*
+ * strhash.h
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef STRHASH_H
+#define STRHASH_H
+
+#include "str.h"
+
+#define STRHASH_OK       (0)
+#define STRHASH_MEMERR  (-1)
+
+#define STRHASH_NOTFOUND (-1)
+
+#define STRHASH_CASE     (0)
+#define STRHASH_NOCASE   (1)
+
+/* strhash
+ *
+ * Open-addressing hash table mapping strings to non-negative long
+ * values. Keys are copied into the table. A table built with
+ * STRHASH_NOCASE matches keys regardless of (ASCII) case.
+ */
+typedef struct strhash {
+	unsigned long n, max;
+	int nocase;
+	str  *keys;
+	long *values;
+	unsigned char *filled;
+} strhash;
+
+void strhash_init ( strhash *h, int nocase );
+void strhash_free ( strhash *h );
+void strhash_empty( strhash *h );
+
+int  strhash_add  ( strhash *h, const char *key, long value );
+int  strhash_set  ( strhash *h, const char *key, long value );
+int  strhash_addn ( strhash *h, const char *key, unsigned long len, long value );
+int  strhash_setn ( strhash *h, const char *key, unsigned long len, long value );
+
+long strhash_find ( strhash *h, const char *key );
+long strhash_findn( strhash *h, const char *key, unsigned long len );
+
+unsigned long strhash_hash( const char *key, unsigned long len, int nocase );
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * adsout_bench.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Write journal articles as ADS with bibl_write_mem(), which looks up
+ * each journal title for the bibcode abbreviation, then time the
+ * linear scan over the journal names that the lookup replaced.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "bibutils.h"
+
+/* the table is static to adsout.c, which includes it the same way */
+#include "adsout_journals.c"
+
+const char progname[] = "adsout_bench";
+
+#define NREFS ( 20000 )
+
+/* title()
+ *
+ * Three in four references are in a listed journal, spread over the
+ * whole table; the others aren't, which makes the scan go to the end.
+ */
+static const char *
+title( int i, char *buf, size_t len )
+{
+	if ( i % 4==3 ) {
+		snprintf( buf, len, "Unlisted Journal of Things %d", i );
+		return buf;
+	}
+	return journals[ ( ( long ) i * 97 ) % njournals ] + 6;
+}
+
+static int
+scan( const char *jrnl )
+{
+	int j;
+
+	for ( j=0; j<njournals; j++ )
+		if ( !strcasecmp( jrnl, journals[j]+6 ) ) return j;
+	return -1;
+}
+
+static int
+make_library( bibl *b )
+{
+	size_t max = ( size_t ) NREFS * 400, len = 0;
+	char *buf, tbuf[64];
+	param p;
+	int i, status;
+
+	buf = malloc( max );
+	if ( !buf ) return BIBL_ERR_MEMERR;
+
+	for ( i=0; i<NREFS; ++i )
+		len += snprintf( buf+len, max-len, "TY  - JOUR\nID  - ref%d\nAU  - Smith, John\n"
+			"TI  - Title %d\nJO  - %s\nPY  - 2004\nVL  - %d\nSP  - %d\nER  - \n\n",
+			i, i, title( i, tbuf, sizeof( tbuf ) ), i % 300, 1 + i % 5000 );
+
+	status = bibl_initparams( &p, BIBL_RISIN, BIBL_ADSABSOUT, ( char * ) progname );
+	if ( status==BIBL_OK ) {
+		p.charsetin     = BIBL_CHARSET_UNICODE;
+		p.charsetin_src = BIBL_SRC_USER;
+		p.utf8in        = 1;
+		status = bibl_read_mem( b, buf, len, "adsout_bench", &p );
+		bibl_freeparams( &p );
+	}
+
+	free( buf );
+	return status;
+}
+
+/* count_abbreviated()
+ *
+ * Bibcodes ("%R YYYYJJJJJ...") whose journal part was filled in
+ */
+static int
+count_abbreviated( const char *out )
+{
+	const char *p = out;
+	int n = 0;
+
+	while ( ( p = strstr( p, "%R " ) ) ) {
+		if ( strlen( p ) > 7 && p[7]!='.' ) n++;
+		p += 3;
+	}
+	return n;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	double twrite, tscan;
+	char *out = NULL, tbuf[64];
+	clock_t start;
+	int i, hits = 0, status;
+	size_t len;
+	param p;
+	bibl b;
+
+	bibl_init( &b );
+	if ( make_library( &b )!=BIBL_OK || b.n!=NREFS ) {
+		printf( "%s: FAILED to read the library\n", progname );
+		return EXIT_FAILURE;
+	}
+
+	status = bibl_initparams( &p, BIBL_RISIN, BIBL_ADSABSOUT, ( char * ) progname );
+	if ( status==BIBL_OK ) {
+		start = clock();
+		status = bibl_write_mem( &b, &out, &len, &p );
+		twrite = ( double ) ( clock() - start ) / CLOCKS_PER_SEC;
+		bibl_freeparams( &p );
+	}
+	if ( status!=BIBL_OK ) {
+		printf( "%s: FAILED to write the library\n", progname );
+		return EXIT_FAILURE;
+	}
+
+	start = clock();
+	for ( i=0; i<NREFS; ++i )
+		if ( scan( title( i, tbuf, sizeof( tbuf ) ) )!=-1 ) hits++;
+	tscan = ( double ) ( clock() - start ) / CLOCKS_PER_SEC;
+
+	printf( "%s: CPU time for %d refs, %d of them in %d listed journals\n",
+		progname, NREFS, hits, njournals );
+	printf( "  bibl_write_mem() to ADS   %8.3f s\n", twrite );
+	printf( "  linear scan of the titles %8.3f s\n", tscan );
+
+	i = count_abbreviated( out );
+	if ( i!=hits ) printf( "%s: %d bibcodes have a journal, not %d\n", progname, i, hits );
+
+	free( out );
+	bibl_free( &b );
+	return ( i==hits ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
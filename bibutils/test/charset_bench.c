@@ -0,0 +1,150 @@
+/*
+ * charset_bench.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Write a UTF-8 library to each 8-bit charset with bibl_write_mem(),
+ * then time charset_lookupuni() against the linear scan it replaced
+ * over the same code points.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bibutils.h"
+#include "charsets.h"
+
+const char progname[] = "charset_bench";
+
+#define NREFS ( 20000 )
+
+/* Latin, Greek and Cyrillic text, most of which each charset lacks */
+static const char *titles[] = {
+	"Über die Größe der Änderungen — ein Überblick",
+	"Étude des déformations élastiques à très basse température",
+	"Ελληνική βιβλιογραφία και ορθογραφία",
+	"Русская библиография: обзор источников",
+	"Łódź, Kraków, Gdańsk: historia miast",
+	"Café “naïve” résumé – façade œuvre",
+};
+
+static const char *authors[] = {
+	"Müller, Jürgen",
+	"Dvořák, Antonín",
+	"Παπαδόπουλος, Γιώργος",
+	"Чайковский, Пётр",
+};
+
+static int
+make_library( bibl *b )
+{
+	size_t max = ( size_t ) NREFS * 200, len = 0;
+	char *buf;
+	param p;
+	int i, status;
+
+	buf = malloc( max );
+	if ( !buf ) return BIBL_ERR_MEMERR;
+
+	for ( i=0; i<NREFS; ++i )
+		len += snprintf( buf+len, max-len, "TY  - JOUR\nID  - ref%d\nAU  - %s\nTI  - %s\nER  - \n\n",
+			i, authors[ i % 4 ], titles[ i % 6 ] );
+
+	status = bibl_initparams( &p, BIBL_RISIN, BIBL_RISOUT, ( char * ) progname );
+	if ( status==BIBL_OK ) {
+		p.charsetin     = BIBL_CHARSET_UNICODE;
+		p.charsetin_src = BIBL_SRC_USER;
+		p.utf8in        = 1;
+		status = bibl_read_mem( b, buf, len, "charset_bench", &p );
+		bibl_freeparams( &p );
+	}
+
+	free( buf );
+	return status;
+}
+
+static int
+write_charset( bibl *b, int n, double *seconds, size_t *len )
+{
+	clock_t start;
+	char *out = NULL;
+	param p;
+	int status;
+
+	status = bibl_initparams( &p, BIBL_RISIN, BIBL_RISOUT, ( char * ) progname );
+	if ( status!=BIBL_OK ) return status;
+
+	p.charsetout     = n;
+	p.charsetout_src = BIBL_SRC_USER;
+	p.utf8out        = 0;
+	p.utf8bom        = 0;
+	p.latexout       = 0;
+
+	start = clock();
+	status = bibl_write_mem( b, &out, len, &p );
+	*seconds = ( double ) ( clock() - start ) / CLOCKS_PER_SEC;
+
+	free( out );
+	bibl_freeparams( &p );
+	return status;
+}
+
+/* time_lookups()
+ *
+ * Look up U+0000-U+04FF (Latin, Greek, Cyrillic) and U+2000-U+207F
+ * (punctuation) in every charset
+ */
+static double
+time_lookups( unsigned int ( *lookup )( int, unsigned int ), unsigned int *check )
+{
+	clock_t start = clock();
+	unsigned int sum = 0;
+	int n, i, rep;
+
+	for ( rep=0; rep<20; ++rep )
+	for ( n=0; n<nallcharconvert; ++n )
+	for ( i=0; i<0x500; ++i )
+		sum += lookup( n, ( unsigned int ) i ) + lookup( n, 0x2000 + ( i & 0x7F ) );
+
+	*check = sum;
+	return ( double ) ( clock() - start ) / CLOCKS_PER_SEC;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	double seconds, total = 0., tscan, ttable;
+	unsigned int sumscan, sumtable;
+	size_t len;
+	int n;
+	bibl b;
+
+	bibl_init( &b );
+	if ( make_library( &b )!=BIBL_OK || b.n!=NREFS ) {
+		printf( "%s: FAILED to read the library\n", progname );
+		return EXIT_FAILURE;
+	}
+
+	printf( "%s: CPU time in bibl_write_mem() for %d UTF-8 refs\n", progname, NREFS );
+
+	for ( n=0; n<nallcharconvert; ++n ) {
+		if ( write_charset( &b, n, &seconds, &len )!=BIBL_OK ) {
+			printf( "%s: FAILED writing %s\n", progname, charset_get_xmlname( n ) );
+			return EXIT_FAILURE;
+		}
+		printf( "  %-24s %8.3f s  %9lu bytes\n", charset_get_xmlname( n ), seconds, ( unsigned long ) len );
+		total += seconds;
+	}
+	printf( "  %-24s %8.3f s\n", "all charsets", total );
+
+	ttable = time_lookups( charset_lookupuni, &sumtable );
+	tscan  = time_lookups( charset_lookupuni_scan, &sumscan );
+	printf( "%s: charset_lookupuni() %.3f s, linear scan %.3f s%s\n", progname,
+		ttable, tscan, ( sumtable==sumscan ) ? "" : " (RESULTS DIFFER)" );
+
+	bibl_free( &b );
+	return ( sumtable==sumscan ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
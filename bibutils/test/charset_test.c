@@ -0,0 +1,92 @@
+/*
+ * charset_test.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Check that charset_lookupuni() gives what the linear scan over each
+ * charset's table gives, including which character wins when several
+ * map to the same code point.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "charsets.h"
+
+const char progname[] = "charset_test";
+
+static int failures = 0;
+
+#define check( cond ) \
+	do { \
+		if ( !(cond) ) { \
+			printf( "%s: %s:%d: check failed: %s\n", progname, __FILE__, __LINE__, #cond ); \
+			failures++; \
+		} \
+	} while ( 0 )
+
+/* Every code point the tables use lies in one of these */
+static const struct {
+	unsigned int first, last;
+} sweep[] = {
+	{ 0x0000,  0x2FFF },
+	{ 0xF000,  0xFFFF },
+	{ 0x10000, 0x10010 },
+	{ 0x10FFFF, 0x10FFFF },
+};
+
+static void
+test_charset( int n )
+{
+	unsigned int u, want, got;
+	int i, bad = 0;
+
+	for ( i=0; i<( int ) ( sizeof( sweep ) / sizeof( sweep[0] ) ); ++i ) {
+		for ( u=sweep[i].first; u<=sweep[i].last; ++u ) {
+			want = charset_lookupuni_scan( n, u );
+			got  = charset_lookupuni( n, u );
+			if ( got==want ) continue;
+			if ( bad++ < 5 )
+				printf( "%s: %s: U+%04X gives %u, not %u\n", progname,
+					charset_get_xmlname( n ), u, got, want );
+		}
+	}
+
+	check( bad==0 );
+}
+
+static void
+test_asciicompatible( int n )
+{
+	int c, ascii = 1;
+
+	for ( c=1; c<128; ++c ) {
+		if ( charset_lookupchar( n, ( char ) c )!=( unsigned int ) c ) ascii = 0;
+		if ( charset_lookupuni_scan( n, c )!=( unsigned int ) c ) ascii = 0;
+	}
+
+	check( charset_asciicompatible( n )==ascii );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int n;
+
+	check( nallcharconvert > 0 );
+
+	for ( n=0; n<nallcharconvert; ++n ) {
+		test_charset( n );
+		test_asciicompatible( n );
+	}
+
+	check( charset_lookupuni( CHARSET_UNICODE, 0x20AC )==0x20AC );
+
+	if ( failures ) {
+		printf( "%s: %d check(s) failed\n", progname, failures );
+		return EXIT_FAILURE;
+	}
+	printf( "%s: all checks passed\n", progname );
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+/*
+ * citekey_bench.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Time bibl_read() on 10k, 100k and 1M references, each citekey
+ * occurring twice. Making the citekeys unique used to be quadratic in
+ * the number of references, so the time per reference should stay
+ * flat as the input grows.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bibutils.h"
+
+const char progname[] = "citekey_bench";
+
+/* make_input()
+ *
+ * RIS references "key0" ... "key<n/2-1>", twice over
+ */
+static FILE *
+make_input( long n )
+{
+	FILE *fp;
+	long i;
+
+	fp = tmpfile();
+	if ( !fp ) return NULL;
+
+	for ( i=0; i<n; ++i )
+		fprintf( fp, "TY  - JOUR\nID  - key%ld\nTI  - T\nER  - \n\n", i % ( n / 2 ) );
+
+	rewind( fp );
+	return fp;
+}
+
+static int
+run( long n )
+{
+	clock_t start;
+	double seconds;
+	param p;
+	bibl b;
+	FILE *fp;
+	int status;
+
+	fp = make_input( n );
+	if ( !fp ) return BIBL_ERR_MEMERR;
+
+	bibl_init( &b );
+	status = bibl_initparams( &p, BIBL_RISIN, BIBL_MODSOUT, ( char * ) progname );
+	if ( status==BIBL_OK ) {
+		start = clock();
+		status = bibl_read( &b, fp, "citekey_bench", &p );
+		seconds = ( double ) ( clock() - start ) / CLOCKS_PER_SEC;
+		if ( status==BIBL_OK )
+			printf( "%8ld refs  %9.3f s  %7.3f us/ref\n", n,
+				seconds, seconds * 1e6 / n );
+		bibl_freeparams( &p );
+	}
+
+	bibl_free( &b );
+	fclose( fp );
+
+	return status;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	long sizes[] = { 10000, 100000, 1000000 };
+	int i, nsizes = sizeof( sizes ) / sizeof( sizes[0] );
+
+	printf( "%s: CPU time in bibl_read()\n", progname );
+
+	for ( i=0; i<nsizes; ++i ) {
+		if ( run( sizes[i] )!=BIBL_OK ) {
+			printf( "%s: FAILED at %ld refs\n", progname, sizes[i] );
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
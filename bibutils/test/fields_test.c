@@ -0,0 +1,171 @@
+/*
+ * fields_test.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Check that lookups and FIELDS_NO_DUPS adds in a fields stay right
+ * when tags and values are edited through str pointers handed out
+ * with FIELDS_STRP_FLAG.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "fields.h"
+
+const char progname[] = "fields_test";
+
+static int failures = 0;
+
+#define check( cond ) \
+	do { \
+		if ( !(cond) ) { \
+			printf( "%s: %s:%d: check failed: %s\n", progname, __FILE__, __LINE__, #cond ); \
+			failures++; \
+		} \
+	} while ( 0 )
+
+/* edit a tag through a pointer kept across other lookups and adds */
+static void
+test_kept_tag_pointer( void )
+{
+	fields f;
+	str *tag;
+
+	fields_init( &f );
+	fields_add( &f, "TITLE", "A title", LEVEL_MAIN );
+	fields_add( &f, "AUTHOR", "Someone", LEVEL_MAIN );
+
+	tag = fields_tag( &f, 0, FIELDS_STRP );
+	check( fields_find( &f, "TITLE", LEVEL_MAIN )==0 );
+	fields_add( &f, "YEAR", "2000", LEVEL_MAIN );
+
+	str_strcpyc( tag, "SHORTTITLE" );
+	check( fields_find( &f, "TITLE", LEVEL_MAIN )==FIELDS_NOTFOUND );
+	check( fields_find( &f, "shorttitle", LEVEL_MAIN )==0 );
+	check( fields_findv( &f, LEVEL_MAIN, FIELDS_CHRP, "SHORTTITLE" )!=NULL );
+
+	str_strcpyc( tag, "SUBTITLE" );
+	check( fields_find( &f, "SHORTTITLE", LEVEL_MAIN )==FIELDS_NOTFOUND );
+	check( fields_find( &f, "SUBTITLE", LEVEL_MAIN )==0 );
+
+	fields_free( &f );
+}
+
+/* a tag moved down by fields_remove() keeps a usable hash */
+static void
+test_remove_after_edit( void )
+{
+	fields f;
+	str *tag;
+
+	fields_init( &f );
+	fields_add( &f, "A", "1", LEVEL_MAIN );
+	fields_add( &f, "B", "2", LEVEL_MAIN );
+	fields_add( &f, "C", "3", LEVEL_MAIN );
+
+	tag = fields_tag( &f, 2, FIELDS_STRP );
+	str_strcpyc( tag, "D" );
+	fields_remove( &f, 0 );
+	check( fields_find( &f, "D", LEVEL_MAIN )==1 );
+	check( fields_find( &f, "C", LEVEL_MAIN )==FIELDS_NOTFOUND );
+
+	fields_free( &f );
+}
+
+/* fill a record past FIELDS_DUPINDEX_MIN so that adds use the index */
+static void
+fill( fields *f, int n )
+{
+	char value[32];
+	int i;
+
+	for ( i=0; i<n; ++i ) {
+		sprintf( value, "value%d", i );
+		fields_add( f, "KEYWORD", value, LEVEL_MAIN );
+	}
+}
+
+/* a value edited through a kept pointer is still seen as a duplicate */
+static void
+test_kept_value_pointer( void )
+{
+	fields f;
+	str *value;
+
+	fields_init( &f );
+	fill( &f, 100 );
+
+	value = fields_value( &f, 10, FIELDS_STRP );
+	fields_add( &f, "KEYWORD", "other", LEVEL_MAIN );
+	check( fields_num( &f )==101 );
+
+	str_strcpyc( value, "edited" );
+	fields_add( &f, "KEYWORD", "EDITED", LEVEL_MAIN );
+	check( fields_num( &f )==101 );
+	fields_add( &f, "KEYWORD", "value10", LEVEL_MAIN );
+	check( fields_num( &f )==102 );
+	fields_add( &f, "KEYWORD", "value11", LEVEL_MAIN );
+	check( fields_num( &f )==102 );
+
+	fields_free( &f );
+}
+
+/* likewise for a tag edited through a kept pointer */
+static void
+test_kept_tag_pointer_dups( void )
+{
+	fields f;
+	str *tag;
+
+	fields_init( &f );
+	fill( &f, 100 );
+
+	tag = fields_tag( &f, 20, FIELDS_STRP );
+	fields_add( &f, "KEYWORD", "other", LEVEL_MAIN );
+
+	str_strcpyc( tag, "NOTE" );
+	fields_add( &f, "note", "value20", LEVEL_MAIN );
+	check( fields_num( &f )==101 );
+	fields_add( &f, "KEYWORD", "value20", LEVEL_MAIN );
+	check( fields_num( &f )==102 );
+
+	fields_free( &f );
+}
+
+/* fields_replace_or_add() keeps the index in step with the new value */
+static void
+test_replace_or_add( void )
+{
+	fields f;
+
+	fields_init( &f );
+	fill( &f, 100 );
+	fields_add( &f, "TITLE", "old", LEVEL_MAIN );
+
+	fields_replace_or_add( &f, "TITLE", "new", LEVEL_MAIN );
+	fields_add( &f, "TITLE", "new", LEVEL_MAIN );
+	check( fields_num( &f )==101 );
+	fields_add( &f, "TITLE", "old", LEVEL_MAIN );
+	check( fields_num( &f )==102 );
+
+	fields_free( &f );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	test_kept_tag_pointer();
+	test_remove_after_edit();
+	test_kept_value_pointer();
+	test_kept_tag_pointer_dups();
+	test_replace_or_add();
+
+	if ( failures ) {
+		printf( "%s: %d check(s) failed\n", progname, failures );
+		return EXIT_FAILURE;
+	}
+	printf( "%s: all checks passed\n", progname );
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/*
+ * gb18030_test.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Round-trip GB18030: every entry of gb18030_enums[], both ends of
+ * each four-byte range and U+10000/U+10FFFF, and check that what
+ * can't be mapped still gives '?'.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gb18030.h"
+
+/* the table is static to gb18030.c, which includes it the same way */
+#include "gb18030_enumeration.c"
+
+const char progname[] = "gb18030_test";
+
+static int failures = 0;
+
+#define check( cond ) \
+	do { \
+		if ( !(cond) ) { \
+			printf( "%s: %s:%d: check failed: %s\n", progname, __FILE__, __LINE__, #cond ); \
+			failures++; \
+		} \
+	} while ( 0 )
+
+/* roundtrip()
+ *
+ * unicode encodes to exactly bytes[0..len-1], and those decode to
+ * unicode, using up all len bytes
+ */
+static int
+roundtrip( unsigned int unicode, const unsigned char *bytes, int len )
+{
+	unsigned char out[4];
+	char in[5] = { 0, 0, 0, 0, 0 };
+	unsigned int pos = 0;
+	int n;
+
+	n = gb18030_encode( unicode, out );
+	if ( n!=len || memcmp( out, bytes, len ) ) return 0;
+
+	memcpy( in, bytes, len );
+	if ( gb18030_decode( in, &pos )!=unicode ) return 0;
+	return ( pos==( unsigned int ) len );
+}
+
+static unsigned int
+decode4( unsigned char b0, unsigned char b1, unsigned char b2, unsigned char b3 )
+{
+	char in[5] = { b0, b1, b2, b3, 0 };
+	unsigned int pos = 0, c;
+
+	c = gb18030_decode( in, &pos );
+	check( pos==4 );
+	return c;
+}
+
+static void
+test_table( void )
+{
+	unsigned int i;
+	int ntwo = 0, bad = 0;
+
+	for ( i=0; i<ngb18030_enums; ++i ) {
+		if ( gb18030_enums[i].len==2 ) ntwo++;
+		if ( !roundtrip( gb18030_enums[i].unicode, gb18030_enums[i].bytes, gb18030_enums[i].len ) ) {
+			if ( bad++ < 10 )
+				printf( "%s: U+%04X does not round-trip\n", progname, gb18030_enums[i].unicode );
+		}
+	}
+
+	check( ntwo==126*190 );
+	check( bad==0 );
+}
+
+/* The four-byte ranges, with the sequences they start and end at */
+static const struct {
+	unsigned int unicode;
+	unsigned char bytes[4];
+} ranges[] = {
+	{ 0x0452,   { 0x81, 0x30, 0xD3, 0x30 } },
+	{ 0x200F,   { 0x81, 0x36, 0xA5, 0x31 } },
+	{ 0x2643,   { 0x81, 0x37, 0xA8, 0x39 } },
+	{ 0x2E80,   { 0x81, 0x38, 0xFD, 0x38 } },
+	{ 0x361B,   { 0x82, 0x30, 0xA6, 0x33 } },
+	{ 0x3917,   { 0x82, 0x30, 0xF2, 0x37 } },
+	{ 0x3CE1,   { 0x82, 0x31, 0xD4, 0x38 } },
+	{ 0x4055,   { 0x82, 0x32, 0xAF, 0x32 } },
+	{ 0x4160,   { 0x82, 0x32, 0xC9, 0x37 } },
+	{ 0x4336,   { 0x82, 0x32, 0xF8, 0x37 } },
+	{ 0x44D7,   { 0x82, 0x33, 0xA3, 0x39 } },
+	{ 0x464B,   { 0x82, 0x33, 0xC9, 0x31 } },
+	{ 0x478E,   { 0x82, 0x33, 0xE8, 0x38 } },
+	{ 0x4946,   { 0x82, 0x34, 0x96, 0x38 } },
+	{ 0x49B8,   { 0x82, 0x34, 0xA1, 0x31 } },
+	{ 0x4C76,   { 0x82, 0x34, 0xE7, 0x33 } },
+	{ 0x9FA6,   { 0x82, 0x35, 0x8F, 0x33 } },
+	{ 0xD7FF,   { 0x83, 0x36, 0xC7, 0x38 } },
+	{ 0xE865,   { 0x83, 0x36, 0xD0, 0x30 } },
+	{ 0xF92B,   { 0x84, 0x30, 0x85, 0x34 } },
+	{ 0xFA2A,   { 0x84, 0x30, 0x9C, 0x38 } },
+	{ 0xFE2F,   { 0x84, 0x31, 0x85, 0x37 } },
+	{ 0xFFE6,   { 0x84, 0x31, 0xA2, 0x34 } },
+	{ 0xFFFF,   { 0x84, 0x31, 0xA4, 0x39 } },
+	{ 0x10000,  { 0x90, 0x30, 0x81, 0x30 } },
+	{ 0x10FFFF, { 0xE3, 0x32, 0x9A, 0x35 } },
+};
+
+static void
+test_ranges( void )
+{
+	int i, n = sizeof( ranges ) / sizeof( ranges[0] );
+
+	check( n==26 );
+	for ( i=0; i<n; ++i ) {
+		if ( !roundtrip( ranges[i].unicode, ranges[i].bytes, 4 ) ) {
+			printf( "%s: U+%04X does not round-trip\n", progname, ranges[i].unicode );
+			failures++;
+		}
+	}
+}
+
+static void
+test_unmapped( void )
+{
+	unsigned char out[4];
+	int n;
+
+	/* surrogates and code points beyond Unicode can't be encoded */
+	n = gb18030_encode( 0xD800, out );
+	check( n==1 && out[0]=='?' );
+	n = gb18030_encode( 0xDFFF, out );
+	check( n==1 && out[0]=='?' );
+	n = gb18030_encode( 0x110000, out );
+	check( n==1 && out[0]=='?' );
+
+	/* just past U+FFFF and past U+10FFFF, no character is assigned */
+	check( decode4( 0x84, 0x31, 0xA5, 0x30 )=='?' );
+	check( decode4( 0x8F, 0x39, 0xFE, 0x39 )=='?' );
+	check( decode4( 0xE3, 0x32, 0x9A, 0x36 )=='?' );
+	check( decode4( 0xFE, 0x39, 0xFE, 0x39 )=='?' );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	test_table();
+	test_ranges();
+	test_unmapped();
+
+	if ( failures ) {
+		printf( "%s: %d check(s) failed\n", progname, failures );
+		return EXIT_FAILURE;
+	}
+	printf( "%s: all checks passed\n", progname );
+	return EXIT_SUCCESS;
+}
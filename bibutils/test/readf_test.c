@@ -0,0 +1,152 @@
+/*
+ * readf_test.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Check that a FILE*-based param.readf set by the caller is still
+ * used, by bibl_read() and bibl_read_mem() alike.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bibutils.h"
+
+const char progname[] = "readf_test";
+
+static int failures = 0;
+
+#define check( cond ) \
+	do { \
+		if ( !(cond) ) { \
+			printf( "%s: %s:%d: check failed: %s\n", progname, __FILE__, __LINE__, #cond ); \
+			failures++; \
+		} \
+	} while ( 0 )
+
+static const char input[] =
+	"TY  - JOUR\n"
+	"ID  - first\n"
+	"TI  - First title\n"
+	"ER  - \n"
+	"\n"
+	"TY  - BOOK\n"
+	"ID  - second\n"
+	"TI  - Second title\n"
+	"ER  - \n";
+
+static int ncalls = 0;
+
+/* old_readf()
+ *
+ * A RIS reader in the style of the readers of earlier releases: one
+ * reference per "ER  -" line, read with str_fget().
+ */
+static int
+old_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+{
+	*fcharset = CHARSET_UNKNOWN;
+	ncalls++;
+
+	while ( str_fget( fp, buf, bufsize, bufpos, line ) ) {
+		if ( str_is_empty( line ) ) continue;
+		if ( !strncmp( str_cstr( line ), "ER  -", 5 ) ) return 1;
+		str_strcat( reference, line );
+		str_addchar( reference, '\n' );
+	}
+
+	return ( reference->len > 0 );
+}
+
+static void
+check_refs( bibl *b )
+{
+	check( b->n==2 );
+	if ( b->n!=2 ) return;
+	check( fields_find( b->ref[0], "REFNUM", LEVEL_ANY )!=FIELDS_NOTFOUND );
+	check( !strcmp( fields_findv( b->ref[0], LEVEL_ANY, FIELDS_CHRP, "REFNUM" ), "first" ) );
+	check( !strcmp( fields_findv( b->ref[1], LEVEL_ANY, FIELDS_CHRP, "REFNUM" ), "second" ) );
+}
+
+static void
+test_read( void )
+{
+	param p;
+	bibl b;
+	FILE *fp;
+
+	fp = tmpfile();
+	check( fp!=NULL );
+	if ( !fp ) return;
+	fputs( input, fp );
+	rewind( fp );
+
+	bibl_init( &b );
+	check( bibl_initparams( &p, BIBL_RISIN, BIBL_MODSOUT, ( char * ) progname )==BIBL_OK );
+	p.readf = old_readf;
+	ncalls = 0;
+
+	check( bibl_read( &b, fp, "readf_test", &p )==BIBL_OK );
+	check( ncalls > 0 );
+	check_refs( &b );
+
+	bibl_free( &b );
+	bibl_freeparams( &p );
+	fclose( fp );
+}
+
+static void
+test_read_mem( void )
+{
+	param p;
+	bibl b;
+
+	bibl_init( &b );
+	check( bibl_initparams( &p, BIBL_RISIN, BIBL_MODSOUT, ( char * ) progname )==BIBL_OK );
+	p.readf = old_readf;
+	ncalls = 0;
+
+	check( bibl_read_mem( &b, input, strlen( input ), "readf_test", &p )==BIBL_OK );
+	check( ncalls > 0 );
+	check_refs( &b );
+
+	bibl_free( &b );
+	bibl_freeparams( &p );
+}
+
+/* An empty buffer has nothing for old_readf() to read */
+static void
+test_read_mem_empty( void )
+{
+	param p;
+	bibl b;
+
+	bibl_init( &b );
+	check( bibl_initparams( &p, BIBL_RISIN, BIBL_MODSOUT, ( char * ) progname )==BIBL_OK );
+	p.readf = old_readf;
+	ncalls = 0;
+
+	check( bibl_read_mem( &b, input, 0, "readf_test", &p )==BIBL_OK );
+	check( ncalls==0 );
+	check( b.n==0 );
+
+	bibl_free( &b );
+	bibl_freeparams( &p );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	test_read();
+	test_read_mem();
+	test_read_mem_empty();
+
+	if ( failures ) {
+		printf( "%s: %d check(s) failed\n", progname, failures );
+		return EXIT_FAILURE;
+	}
+	printf( "%s: all checks passed\n", progname );
+	return EXIT_SUCCESS;
+}
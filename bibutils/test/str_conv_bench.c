@@ -0,0 +1,107 @@
+/*
+ * str_conv_bench.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Time str_convert() against str_convert_generic() for the read and
+ * write charset pairs the formats use most, on field-like strings that
+ * are mostly ASCII.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "str.h"
+#include "str_conv.h"
+#include "charsets.h"
+
+const char progname[] = "str_conv_bench";
+
+#define NCONVERT ( 2000000 )
+
+/* the same text in UTF-8, Latin-1, LaTeX and GB18030 */
+static const char *utf8[] = {
+	"2004", "Journal of Applied Physics", "Smith, John",
+	"M\xC3\xBCller, J\xC3\xBCrgen", "Ab initio study of the electronic structure",
+	"Caf\xC3\xA9 culture & society", "123--145", "10.1000/xyz123",
+};
+static const char *latin1[] = {
+	"2004", "Journal of Applied Physics", "Smith, John",
+	"M\xFCller, J\xFCrgen", "Ab initio study of the electronic structure",
+	"Caf\xE9 culture & society", "123--145", "10.1000/xyz123",
+};
+static const char *latex[] = {
+	"2004", "Journal of Applied Physics", "Smith, John",
+	"M{\\\"u}ller, J{\\\"u}rgen", "Ab initio study of the electronic structure",
+	"Caf{\\'e} culture \\& society", "123--145", "10.1000/xyz123",
+};
+static const char *gb[] = {
+	"2004", "Journal of Applied Physics", "Smith, John",
+	"\xD6\xD0\xCE\xC4 \xB2\xE2\xCA\xD4", "Ab initio study of the electronic structure",
+	"\xCE\xC4\xBB\xAF & society", "123--145", "10.1000/xyz123",
+};
+
+#define NSTRINGS ( sizeof( utf8 ) / sizeof( utf8[0] ) )
+
+typedef int ( *convert_fn )( str *s, int, int, int, int, int, int, int, int );
+
+typedef struct pair_t {
+	const char *name;
+	const char **input;
+	int charsetin, latexin, utf8in, xmlin;
+	int charsetout, latexout, utf8out, xmlout;
+} pair_t;
+
+static double
+run( convert_fn convert, pair_t *p )
+{
+	clock_t start;
+	str s;
+	long i;
+
+	str_init( &s );
+
+	start = clock();
+	for ( i=0; i<NCONVERT; ++i ) {
+		str_strcpyc( &s, p->input[ i % NSTRINGS ] );
+		convert( &s, p->charsetin, p->latexin, p->utf8in, p->xmlin,
+			p->charsetout, p->latexout, p->utf8out, p->xmlout );
+	}
+
+	str_free( &s );
+	return ( double ) ( clock() - start ) / CLOCKS_PER_SEC;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int latin = charset_find( "ISO-8859-1" );
+	pair_t pairs[] = {
+		{ "UTF-8 -> UTF-8",            utf8,   CHARSET_UNICODE, 0, 1, 0, CHARSET_UNICODE, 0, 1, 0 },
+		{ "UTF-8 -> UTF-8 XML",        utf8,   CHARSET_UNICODE, 0, 1, 0, CHARSET_UNICODE, 0, 1, STR_CONV_XMLOUT_TRUE },
+		{ "UTF-8 XML -> UTF-8",        utf8,   CHARSET_UNICODE, 0, 1, 1, CHARSET_UNICODE, 0, 1, 0 },
+		{ "LaTeX -> UTF-8",            latex,  CHARSET_UNICODE, 1, 1, 0, CHARSET_UNICODE, 0, 1, 0 },
+		{ "UTF-8 -> LaTeX",            utf8,   CHARSET_UNICODE, 0, 1, 0, CHARSET_UNICODE, 1, 0, 0 },
+		{ "Latin-1 -> UTF-8",          latin1, latin,           0, 0, 0, CHARSET_UNICODE, 0, 1, 0 },
+		{ "UTF-8 -> Latin-1",          utf8,   CHARSET_UNICODE, 0, 1, 0, latin,           0, 0, 0 },
+		{ "GB18030 -> UTF-8",          gb,     CHARSET_GB18030, 0, 0, 0, CHARSET_UNICODE, 0, 1, 0 },
+		{ "UTF-8 -> GB18030",          utf8,   CHARSET_UNICODE, 0, 1, 0, CHARSET_GB18030, 0, 0, 0 },
+	};
+	int i, npairs = sizeof( pairs ) / sizeof( pairs[0] );
+	double tk, tg;
+
+	printf( "%s: CPU time for %d conversions\n", progname, NCONVERT );
+	printf( "  %-22s %9s %9s %7s\n", "", "kernels", "generic", "speedup" );
+
+	for ( i=0; i<npairs; ++i ) {
+		tk = run( str_convert, &(pairs[i]) );
+		tg = run( str_convert_generic, &(pairs[i]) );
+		printf( "  %-22s %7.3f s %7.3f s %6.2fx\n", pairs[i].name, tk, tg,
+			( tk > 0. ) ? tg / tk : 0. );
+	}
+
+	return EXIT_SUCCESS;
+}
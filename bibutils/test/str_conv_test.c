@@ -0,0 +1,127 @@
+/*
+ * str_conv_test.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Check that str_convert(), with the decoder and encoder chosen once
+ * by str_converter_init() and the unchanged-ASCII fast path, gives the
+ * same output as str_convert_generic() for every option set.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "str.h"
+#include "str_conv.h"
+#include "charsets.h"
+
+const char progname[] = "str_conv_test";
+
+static int failures = 0;
+
+#define check( cond ) \
+	do { \
+		if ( !(cond) ) { \
+			printf( "%s: %s:%d: check failed: %s\n", progname, __FILE__, __LINE__, #cond ); \
+			failures++; \
+		} \
+	} while ( 0 )
+
+/* Short enough to stay inside a str's first allocation, so that the
+ * multibyte decoders may look a few bytes past the end of any of them.
+ */
+static const char *inputs[] = {
+	"Plain ASCII title",
+	"Tom & Jerry <\"quoted\"> 'single'",
+	"Stra{\\ss}e {\\\"u}ber \\alpha $x^2$ -- end",
+	"Gr\xC3\xB6\xC3\x9F" "e \xCE\x95\xCE\xBB\xCE\xBB\xCE\xAC\xCE\xB4\xCE\xB1",
+	"caf\xE9 na\xEFve \xD1\xCE",
+	"&amp; &#233; &#x3B1; &eacute; &bogus;",
+	"\xD6\xD0\xCE\xC4 \x81\x30\x81\x30 ok",
+	"ASCII prefix, then {\\'e} and \xC3\xA9",
+	"x",
+};
+
+static int charsetins[5], charsetouts[4];
+static int xmlouts[] = { STR_CONV_XMLOUT_FALSE, STR_CONV_XMLOUT_TRUE, STR_CONV_XMLOUT_ENTITIES };
+
+static int
+same( const char *input,
+	int charsetin, int latexin, int utf8in, int xmlin,
+	int charsetout, int latexout, int utf8out, int xmlout )
+{
+	str a, b;
+	int ok;
+
+	str_initstrc( &a, input );
+	str_initstrc( &b, input );
+
+	str_convert( &a, charsetin, latexin, utf8in, xmlin, charsetout, latexout, utf8out, xmlout );
+	str_convert_generic( &b, charsetin, latexin, utf8in, xmlin, charsetout, latexout, utf8out, xmlout );
+
+	ok = ( a.len==b.len && !memcmp( str_cstr( &a ), str_cstr( &b ), a.len ) );
+
+	str_free( &a );
+	str_free( &b );
+	return ok;
+}
+
+static void
+test_options( void )
+{
+	int in, latexin, utf8in, xmlin, out, latexout, utf8out, xo, i;
+	int nsets = 0, bad = 0;
+
+	for ( in=0; in<5; ++in )
+	for ( latexin=0; latexin<2; ++latexin )
+	for ( utf8in=0; utf8in<2; ++utf8in )
+	for ( xmlin=0; xmlin<2; ++xmlin )
+	for ( out=0; out<4; ++out )
+	for ( latexout=0; latexout<2; ++latexout )
+	for ( utf8out=0; utf8out<2; ++utf8out )
+	for ( xo=0; xo<3; ++xo ) {
+		nsets++;
+		for ( i=0; i<( int ) ( sizeof( inputs ) / sizeof( inputs[0] ) ); ++i ) {
+			if ( same( inputs[i], charsetins[in], latexin, utf8in, xmlin,
+			           charsetouts[out], latexout, utf8out, xmlouts[xo] ) ) continue;
+			if ( bad++ < 10 )
+				printf( "%s: input %d differs for in=%d latexin=%d utf8in=%d xmlin=%d "
+					"out=%d latexout=%d utf8out=%d xmlout=%d\n", progname, i,
+					charsetins[in], latexin, utf8in, xmlin,
+					charsetouts[out], latexout, utf8out, xmlouts[xo] );
+		}
+	}
+
+	check( nsets==5*2*2*2*4*2*2*3 );
+	check( bad==0 );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	charsetins[0] = CHARSET_UNICODE;
+	charsetins[1] = CHARSET_GB18030;
+	charsetins[2] = charset_find( "ISO-8859-1" );
+	charsetins[3] = charset_find( "CP1251" );
+	charsetins[4] = charset_find( "EBC037" );   /* not ASCII compatible */
+
+	charsetouts[0] = CHARSET_UNICODE;
+	charsetouts[1] = CHARSET_GB18030;
+	charsetouts[2] = charset_find( "ISO-8859-1" );
+	charsetouts[3] = charset_find( "EBC037" );
+
+	check( charsetins[2]!=CHARSET_UNKNOWN );
+	check( charsetins[3]!=CHARSET_UNKNOWN );
+	check( charsetins[4]!=CHARSET_UNKNOWN );
+
+	test_options();
+
+	if ( failures ) {
+		printf( "%s: %d check(s) failed\n", progname, failures );
+		return EXIT_FAILURE;
+	}
+	printf( "%s: all checks passed\n", progname );
+	return EXIT_SUCCESS;
+}
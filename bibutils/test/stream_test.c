@@ -0,0 +1,252 @@
+/*
+ * stream_test.c
+ *
+ * Copyright (c) hs-bibutils contributors 2026
+ *
+ * Source code released under the GPL version 2
+ *
+ * Check that bibl_convert_stream() writes exactly what bibl_read()
+ * followed by bibl_write() does, for input that can be seeked (and is
+ * read in several passes) and for piped input (read once), and that
+ * bibl_read() writes the same with param.usearena set.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "bibutils.h"
+
+const char progname[] = "stream_test";
+
+static int failures = 0;
+
+#define check( cond ) \
+	do { \
+		if ( !(cond) ) { \
+			printf( "%s: %s:%d: check failed: %s\n", progname, __FILE__, __LINE__, #cond ); \
+			failures++; \
+		} \
+	} while ( 0 )
+
+/* BibTeX with a crossref chain (a -> proc -> series, with series after
+ * proc), a crossref in other case (b -> Proc), a dangling crossref,
+ * an @STRING macro and a citekey occurring three times.
+ */
+static const char bibtex[] =
+	"@string{pub = \"Big Press\"}\n"
+	"@inproceedings{a, author={Smith, John}, title={Paper A}, crossref={proc}, year=2000}\n"
+	"@book{x, author={Doe, Jane}, title={X One}}\n"
+	"@inproceedings{b, author={Smith, John}, title={Paper B}, crossref={Proc}}\n"
+	"@proceedings{proc, title={Proceedings of Things}, publisher=pub, year=2001, crossref={series}}\n"
+	"@book{x, author={Doe, Jane}, title={X Two}}\n"
+	"@misc{series, title={The Series}, publisher={Series Pub}}\n"
+	"@article{y, title={Dangling}, crossref={nothere}}\n"
+	"@book{x, title={X Three}}\n";
+
+/* RIS with a citekey occurring twice and references without one */
+static const char ris[] =
+	"TY  - JOUR\nID  - dup\nAU  - Smith, J\nPY  - 2000\nTI  - A\nER  - \n\n"
+	"TY  - JOUR\nAU  - Smith, J\nPY  - 2000\nTI  - B\nER  - \n\n"
+	"TY  - BOOK\nID  - dup\nAU  - Roe, K\nTI  - C\nER  - \n\n"
+	"TY  - BOOK\nAU  - Roe, K\nTI  - D\nER  - \n\n";
+
+/* slurp()
+ *
+ * The contents of fp from the start, as a '\0'-terminated string
+ */
+static char *
+slurp( FILE *fp, size_t *len )
+{
+	size_t n = 0, max = 4096, got;
+	char *buf, *tmp;
+
+	rewind( fp );
+
+	buf = malloc( max );
+	if ( !buf ) return NULL;
+
+	while ( ( got = fread( buf+n, 1, max-n-1, fp ) ) > 0 ) {
+		n += got;
+		if ( max-n-1 > 0 ) continue;
+		tmp = realloc( buf, max*2 );
+		if ( !tmp ) { free( buf ); return NULL; }
+		buf = tmp;
+		max *= 2;
+	}
+
+	buf[n] = '\0';
+	*len = n;
+	return buf;
+}
+
+/* open_seekable()
+ */
+static FILE *
+open_seekable( const char *input )
+{
+	FILE *fp;
+
+	fp = tmpfile();
+	if ( !fp ) return NULL;
+	fputs( input, fp );
+	rewind( fp );
+	return fp;
+}
+
+/* open_piped()
+ *
+ * The read end of a pipe that a child process writes input to
+ */
+static FILE *
+open_piped( const char *input, pid_t *pid )
+{
+	int fd[2];
+	size_t len;
+
+	if ( pipe( fd ) ) return NULL;
+
+	*pid = fork();
+	if ( *pid < 0 ) {
+		close( fd[0] );
+		close( fd[1] );
+		return NULL;
+	}
+
+	if ( *pid==0 ) {
+		close( fd[0] );
+		len = strlen( input );
+		_exit( write( fd[1], input, len )==( ssize_t ) len ? 0 : 1 );
+	}
+
+	close( fd[1] );
+	return fdopen( fd[0], "r" );
+}
+
+/* convert()
+ *
+ * Convert input with bibl_read()/bibl_write() (how 0, or how 3 with
+ * the references read into an arena), or with bibl_convert_stream()
+ * on seekable (how 1) or piped (how 2) input.
+ */
+static char *
+convert( const char *input, int readmode, int writemode, int how, size_t *len )
+{
+	FILE *in, *out;
+	char *result = NULL;
+	pid_t pid = -1;
+	int status;
+	param p;
+	bibl b;
+
+	if ( how==2 ) in = open_piped( input, &pid );
+	else in = open_seekable( input );
+	check( in!=NULL );
+	if ( !in ) return NULL;
+
+	out = tmpfile();
+	check( out!=NULL );
+	if ( !out ) { fclose( in ); return NULL; }
+
+	check( bibl_initparams( &p, readmode, writemode, ( char * ) progname )==BIBL_OK );
+
+	if ( how==0 || how==3 ) {
+		p.usearena = ( how==3 );
+		bibl_init( &b );
+		status = bibl_read( &b, in, "stream_test", &p );
+		check( status==BIBL_OK );
+		if ( status==BIBL_OK ) {
+			status = bibl_write( &b, out, &p );
+			check( status==BIBL_OK );
+		}
+		bibl_free( &b );
+	}
+	else {
+		status = bibl_convert_stream( in, "stream_test", out, &p, &p );
+		check( status==BIBL_OK );
+	}
+
+	if ( status==BIBL_OK ) result = slurp( out, len );
+
+	bibl_freeparams( &p );
+	fclose( out );
+	fclose( in );
+	if ( pid > 0 ) waitpid( pid, NULL, 0 );
+
+	return result;
+}
+
+static void
+test_same( const char *input, int readmode, int writemode )
+{
+	char *expected, *seekable, *piped, *arena;
+	size_t nexpected = 0, nseekable = 0, npiped = 0, narena = 0;
+
+	expected = convert( input, readmode, writemode, 0, &nexpected );
+	seekable = convert( input, readmode, writemode, 1, &nseekable );
+	piped    = convert( input, readmode, writemode, 2, &npiped );
+	arena    = convert( input, readmode, writemode, 3, &narena );
+
+	check( expected!=NULL && nexpected > 0 );
+	if ( expected && seekable ) {
+		check( nseekable==nexpected );
+		check( !memcmp( seekable, expected, nexpected<nseekable ? nexpected : nseekable ) );
+	}
+	if ( expected && piped ) {
+		check( npiped==nexpected );
+		check( !memcmp( piped, expected, nexpected<npiped ? nexpected : npiped ) );
+	}
+	if ( expected && arena ) {
+		check( narena==nexpected );
+		check( !memcmp( arena, expected, nexpected<narena ? nexpected : narena ) );
+	}
+
+	free( expected );
+	free( seekable );
+	free( piped );
+	free( arena );
+}
+
+/* test_citekeys()
+ *
+ * The duplicated citekey has to have been made unique, or the
+ * comparisons above prove little.
+ */
+static void
+test_citekeys( void )
+{
+	char *out;
+	size_t len;
+
+	out = convert( bibtex, BIBL_BIBTEXIN, BIBL_BIBTEXOUT, 1, &len );
+	check( out!=NULL );
+	if ( !out ) return;
+	check( strstr( out, "{xa," )!=NULL );
+	check( strstr( out, "{xb," )!=NULL );
+	check( strstr( out, "{xc," )!=NULL );
+	check( strstr( out, "booktitle=\"Proceedings of Things\"" )!=NULL );
+	free( out );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	/* the inputs are meant to give warnings; keep them out of the way */
+	if ( !freopen( "/dev/null", "w", stderr ) ) return EXIT_FAILURE;
+
+	test_same( bibtex, BIBL_BIBTEXIN, BIBL_BIBTEXOUT );
+	test_same( bibtex, BIBL_BIBTEXIN, BIBL_MODSOUT );
+	test_same( bibtex, BIBL_BIBLATEXIN, BIBL_RISOUT );
+	test_same( ris, BIBL_RISIN, BIBL_BIBTEXOUT );
+	test_same( ris, BIBL_RISIN, BIBL_ENDNOTEOUT );
+	test_citekeys();
+
+	if ( failures ) {
+		printf( "%s: %d check(s) failed\n", progname, failures );
+		return EXIT_FAILURE;
+	}
+	printf( "%s: all checks passed\n", progname );
+	return EXIT_SUCCESS;
+}
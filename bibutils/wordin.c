@@ -16,7 +16,7 @@
 #include "xml_encoding.h"
 #include "bibformats.h"
 
-static int wordin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset );
+static int wordin_readf( inbuf *in, str *line, str *reference, int *fcharset );
 static int wordin_processf( fields *wordin, const char *data, const char *filename, long nref, param *p );
 
 
@@ -39,7 +39,8 @@ wordin_initparams( param *pm, const char *progname )
 	pm->output_raw       = BIBL_RAW_WITHMAKEREFID |
 	                      BIBL_RAW_WITHCHARCONVERT;
 
-	pm->readf    = wordin_readf;
+	pm->readf    = NULL;
+	pm->readbuf  = wordin_readf;
 	pm->processf = wordin_processf;
 	pm->cleanf   = NULL;
 	pm->typef    = NULL;
@@ -76,13 +77,13 @@ wordin_findendwrapper( char *buf, int ntype )
 }
 
 static int
-wordin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
+wordin_readf( inbuf *in, str *line, str *reference, int *fcharset )
 {
 	str tmp;
 	char *startptr = NULL, *endptr;
 	int haveref = 0, inref = 0, file_charset = CHARSET_UNKNOWN, m, type = 1;
 	str_init( &tmp );
-	while ( !haveref && str_fget( fp, buf, bufsize, bufpos, line ) ) {
+	while ( !haveref && inbuf_getstr( in, line ) ) {
 		if ( str_cstr( line ) ) {
 			m = xml_getencoding( line );
 			if ( m!=CHARSET_UNKNOWN ) file_charset = m;